@@ -1,11 +1,35 @@
 #include "apeng.h"
 
 #include <cassert>
+#include <climits>
+#include <cmath>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <png.h>	//! MUST point to apng-patched libpng/png.h
-
+#include <zlib.h>
+
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#else
+#include <io.h>
+#endif	// _WIN32
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <list>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 ///////////////////////////////////////////////////////////////////////////////
 //! make sure we have proper support for APNG through patched libpng
@@ -15,6 +39,45 @@
 #error "libPNG missing support for APNG. Make sure you use the PATCHED version"
 #endif	// PNG_APNG_SUPPORTED
 
+///////////////////////////////////////////////////////////////////////////////
+//! SIMD
+//! rationale: SSE2 is baseline on x86-64, everything else takes the scalar paths
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define APENG_SSE2 1
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif	// _MSC_VER
+
+namespace
+{
+	//! index of the lowest set bit, mask must be non-zero
+	inline unsigned int lowest_bit_index(unsigned int mask)
+	{
+#ifdef _MSC_VER
+		unsigned long idx;
+		_BitScanForward(&idx, mask);
+		return idx;
+#else
+		return __builtin_ctz(mask);
+#endif	// _MSC_VER
+	}
+
+	//! index of the highest set bit, mask must be non-zero
+	inline unsigned int highest_bit_index(unsigned int mask)
+	{
+#ifdef _MSC_VER
+		unsigned long idx;
+		_BitScanReverse(&idx, mask);
+		return idx;
+#else
+		return 31 - __builtin_clz(mask);
+#endif	// _MSC_VER
+	}
+}	// namespace
+#endif	// SSE2
+
 ///////////////////////////////////////////////////////////////////////////////
 //! globals
 
@@ -23,13 +86,101 @@ enum struct APENG_ERROR : unsigned int
 	no_error = 0,
 	file_invalid,
 	data_invalid,
+	argument_invalid,
+	unsupported,
+	out_of_memory,
+	size_overflow,
 };
 
+//! a * b, false if the product does not fit into size_t
+inline bool checked_mul(size_t a, size_t b, size_t& result)
+{
+	if (a != 0 && b > SIZE_MAX / a)
+	{
+		return false;
+	}
+	result = a * b;
+	return true;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 //! writer
 
 //--- save API
 
+namespace
+{
+	unsigned int encode_frames(FILE*		   file,
+							   const uint8_t** frames_array,
+							   unsigned int	frames,
+							   unsigned int	width,
+							   unsigned int	height,
+							   unsigned int	colortype,
+							   size_t		   rowbytes)
+	{
+		assert(file);
+		assert(frames_array);
+
+
+		// void save_png(unsigned char* p_frame, unsigned int w, unsigned int h, unsigned int d, unsigned int t, unsigned
+		// int frames)
+
+		png_structp png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+		assert(png_ptr);
+		png_infop info_ptr = png_create_info_struct(png_ptr);
+		assert(info_ptr);
+
+		if (png_ptr != nullptr && info_ptr != nullptr && setjmp(png_jmpbuf(png_ptr)) == 0)
+		{
+			png_init_io(png_ptr, file);
+			png_set_compression_level(png_ptr, 9);
+			unsigned int bitdepth = 8; //TODO: compute from channels
+			png_set_IHDR(png_ptr, info_ptr, width, height, bitdepth, colortype, 0, 0, 0);
+
+#ifdef PNG_APNG_SUPPORTED
+			png_set_acTL(png_ptr, info_ptr, frames, 0);
+// png_set_first_frame_is_hidden(png_ptr, info_ptr, 1);
+
+#endif	// PNG_APNG_SUPPORTED
+
+			png_write_info(png_ptr, info_ptr);
+
+			png_bytepp rows = (png_bytepp)malloc(height * sizeof(png_bytep));
+			if (!rows)
+			{
+				png_destroy_write_struct(&png_ptr, &info_ptr);
+				return (unsigned int)APENG_ERROR::out_of_memory;
+			}
+
+			for (unsigned int frameIdx = 0; frameIdx < frames; ++frameIdx)
+			{
+				for (unsigned int rowIdx = 0; rowIdx < height; ++rowIdx)
+				{
+					rows[rowIdx] = (png_bytep)(frames_array[frameIdx] + rowIdx * rowbytes);
+				}
+
+#ifdef PNG_APNG_SUPPORTED
+				png_write_frame_head(png_ptr, info_ptr, nullptr, width, height, 0, 0, 12, 100, PNG_DISPOSE_OP_NONE, PNG_BLEND_OP_SOURCE);
+#endif	// PNG_APNG_SUPPORTED
+
+				png_write_image(png_ptr, rows);
+
+#ifdef PNG_APNG_SUPPORTED
+				png_write_frame_tail(png_ptr, info_ptr);
+#endif	// PNG_APNG_SUPPORTED
+			}
+
+			free(rows);
+
+			png_write_end(png_ptr, info_ptr);
+		}
+		png_destroy_write_struct(&png_ptr, &info_ptr);
+
+		return (unsigned int)APENG_ERROR::no_error;
+	}
+}	// namespace
+
+
 //! apeng_save_frames_file_blob
 //! saves all frames from large buffer frame_blob
 //!  frame_blob must be deleted by user using free()
@@ -41,18 +192,49 @@ APENG_DLLIMPORT unsigned int APENG_API apeng_save_frames_file_blob(FILE*		  file
 																   unsigned int   colortype,
 																   unsigned int   rowbytes,
 																   unsigned int   frames)
+{
+	return apeng_save_frames_file_blob64(file, frames_blob, frames_blob_size, width, height, colortype, rowbytes, frames);
+}
+
+
+//! apeng_save_frames_file_blob64
+//! saves all frames from large buffer frame_blob, with 64-bit sizes
+//!  frame_blob must be deleted by user using free()
+APENG_DLLIMPORT unsigned int APENG_API apeng_save_frames_file_blob64(FILE*		  file,
+																	 const uint8_t* frames_blob,
+																	 size_t		  frames_blob_size,
+																	 unsigned int   width,
+																	 unsigned int   height,
+																	 unsigned int   colortype,
+																	 size_t		  rowbytes,
+																	 unsigned int   frames)
 {
 	assert(frames_blob);
-	assert(frames_blob_size % (height * rowbytes) == 0);
-	assert(frames_blob_size / (height * rowbytes * frames) == 1);
 
-	uint8_t** frames_array = (uint8_t**)malloc(frames * sizeof(uint8_t*));
+	size_t framesize;
+	size_t blobsize;
+	size_t arraysize;
+	if (!checked_mul(height, rowbytes, framesize) || !checked_mul(framesize, frames, blobsize)
+		|| !checked_mul(frames, sizeof(uint8_t*), arraysize))
+	{
+		return (unsigned int)APENG_ERROR::size_overflow;
+	}
+	if (frames_blob_size != blobsize)
+	{
+		return (unsigned int)APENG_ERROR::argument_invalid;
+	}
+
+	const uint8_t** frames_array = (const uint8_t**)malloc(arraysize);
+	if (!frames_array)
+	{
+		return (unsigned int)APENG_ERROR::out_of_memory;
+	}
 	for (unsigned int i = 0; i < frames; ++i)
 	{
-		frames_array[i] = (uint8_t*)&frames_blob[i * height * rowbytes];
+		frames_array[i] = frames_blob + i * framesize;
 	}
 
-	unsigned int err = apeng_save_frames_file(file, (const uint8_t**)frames_array, frames, width, height, colortype, rowbytes);
+	unsigned int err = encode_frames(file, frames_array, frames, width, height, colortype, rowbytes);
 
 	free(frames_array);
 
@@ -69,8 +251,7 @@ APENG_DLLIMPORT unsigned int APENG_API apeng_save_frames_file_nt(
 	assert(frames_array);
 	unsigned int frames = 0;
 
-	const uint8_t* cur_frames = *frames_array;
-	while (cur_frames != nullptr)
+	while (frames_array[frames] != nullptr)
 	{
 		++frames;
 	}
@@ -89,62 +270,7 @@ APENG_DLLIMPORT unsigned int APENG_API apeng_save_frames_file(FILE*			  file,
 															  unsigned int	colortype,
 															  unsigned int	rowbytes)
 {
-	assert(file);
-	assert(frames_array);
-
-
-	// void save_png(unsigned char* p_frame, unsigned int w, unsigned int h, unsigned int d, unsigned int t, unsigned
-	// int frames)
-
-	png_structp png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
-	assert(png_ptr);
-	png_infop info_ptr = png_create_info_struct(png_ptr);
-	assert(info_ptr);
-
-	if (png_ptr != nullptr && info_ptr != nullptr && setjmp(png_jmpbuf(png_ptr)) == 0)
-	{
-		png_init_io(png_ptr, file);
-		png_set_compression_level(png_ptr, 9);
-		unsigned int channels = rowbytes / width;
-		unsigned int bitdepth = 8; //TODO: compute from channels
-		png_set_IHDR(png_ptr, info_ptr, width, height, bitdepth, colortype, 0, 0, 0);
-
-#ifdef PNG_APNG_SUPPORTED
-		png_set_acTL(png_ptr, info_ptr, frames, 0);
-// png_set_first_frame_is_hidden(png_ptr, info_ptr, 1);
-
-#endif	// PNG_APNG_SUPPORTED
-
-		png_write_info(png_ptr, info_ptr);
-
-		png_bytepp rows = (png_bytepp)malloc(height * sizeof(png_bytep));
-		assert(rows);
-
-		for (unsigned int frameIdx = 0; frameIdx < frames; ++frameIdx)
-		{
-			for (unsigned int rowIdx = 0; rowIdx < height; ++rowIdx)
-			{
-				rows[rowIdx] = (png_bytep)(frames_array[frameIdx] + (rowIdx * rowbytes));
-			}
-
-#ifdef PNG_APNG_SUPPORTED
-			png_write_frame_head(png_ptr, info_ptr, nullptr, width, height, 0, 0, 12, 100, PNG_DISPOSE_OP_NONE, PNG_BLEND_OP_SOURCE);
-#endif	// PNG_APNG_SUPPORTED
-
-			png_write_image(png_ptr, rows);
-
-#ifdef PNG_APNG_SUPPORTED
-			png_write_frame_tail(png_ptr, info_ptr);
-#endif	// PNG_APNG_SUPPORTED
-		}
-
-		free(rows);
-
-		png_write_end(png_ptr, info_ptr);
-	}
-	png_destroy_write_struct(&png_ptr, &info_ptr);
-
-	return (unsigned int)APENG_ERROR::no_error;
+	return encode_frames(file, frames_array, frames, width, height, colortype, rowbytes);
 }
 
 
@@ -166,6 +292,24 @@ APENG_DLLIMPORT unsigned int APENG_API apeng_save_frames_blob(const char*	filena
 }
 
 
+//! apeng_save_frames_blob64
+//! saves all frames from large buffer frame_blob, with 64-bit sizes
+//!  frame_blob must be deleted by user using free()
+APENG_DLLIMPORT unsigned int APENG_API apeng_save_frames_blob64(const char*	filename,
+																const uint8_t* frames_blob,
+																size_t		   frames_blob_size,
+																unsigned int   width,
+																unsigned int   height,
+																unsigned int   colortype,
+																size_t		   rowbytes,
+																unsigned int   frames)
+{
+	std::shared_ptr<FILE> file(fopen(filename, "wb"), fclose);
+	assert(file);
+	return apeng_save_frames_file_blob64(file.get(), frames_blob, frames_blob_size, width, height, colortype, rowbytes, frames);
+}
+
+
 //! apeng_save_frames_nt
 //! saves all frames from nullptr-terminated array of buffers
 //! all buffers and the returned array must be deleted using free()
@@ -196,201 +340,2882 @@ APENG_DLLIMPORT unsigned int APENG_API apeng_save_frames(const char*	 filename,
 ///////////////////////////////////////////////////////////////////////////////
 //! loader
 
-//! apeng_load_frames_file_blob
-//! loads all frames into large buffer frame_blob
-//!  frame_blob must be deleted by user using free()
-APENG_DLLIMPORT unsigned int APENG_API apeng_load_frames_file_blob(FILE*		 file,
-																   uint8_t**	 frames_blob,
-																   unsigned int* frames_blob_size,
-																   unsigned int* width,
-																   unsigned int* height,
-																   unsigned int* channels,
-																   unsigned int* rowbytes,
-																   unsigned int* frames)
+namespace
 {
-	uint8_t**	temp_frames_array;
-	unsigned int err = apeng_load_frames_file(file, &temp_frames_array, frames, width, height, channels, rowbytes);
+	//! header of a decoded animation, after libpng transforms
+	struct frames_header
+	{
+		unsigned int frames;	//! number of output frames, without a hidden default image
+		unsigned int width;
+		unsigned int height;
+		unsigned int channels;
+		size_t		 rowbytes;
+	};
+
+	//! receives the composited frames of decode_frames()
+	class frame_receiver
+	{
+	public:
+		virtual ~frame_receiver() = default;
 
-	*frames_blob = (uint8_t*)malloc((*frames) * (*height) * (*rowbytes) * sizeof(uint8_t));
+		//! called once, before the first frame
+		virtual unsigned int begin(const frames_header& header) = 0;
 
-	for (unsigned int i = 0; i < *frames; ++i)
+		//! called for every output frame
+		//!  canvas is the full composited frame and is only valid during the call
+		virtual unsigned int frame(unsigned int frameIdx, const uint8_t* canvas, const apeng_frame_info& info) = 0;
+	};
+
+	//! buffers used while decoding
+	//! rationale: kept out of the setjmp() frame so a libpng error can release them
+	struct decode_state
 	{
-		memcpy(&frames_blob[i * (*height) * (*rowbytes)], temp_frames_array[i], (*height) * (*rowbytes));
-		free(temp_frames_array[i]);
-	}
+		png_bytepp rows;
+		uint8_t*   canvas;		//! composited output frame
+		uint8_t*   frame;		//! current subframe, as decoded
+		uint8_t*   previous;	//! canvas region saved for PNG_DISPOSE_OP_PREVIOUS
+		uint8_t*   last;		//! previous output frame, for APENG_DIRTY_RECT_DIFF
+		uint8_t*   scaled;		//! downscaled output frame
+		uint32_t*  sums;		//! downscale accumulators, one row of output pixels
+		uint8_t*   keep;		//! per animation frame, non-zero if it is output
+	};
+
+	void rect_union(apeng_frame_info& info, unsigned int x, unsigned int y, unsigned int width, unsigned int height)
+	{
+		if (width == 0 || height == 0)
+		{
+			return;
+		}
+		if (info.width == 0 || info.height == 0)
+		{
+			info.x		= x;
+			info.y		= y;
+			info.width  = width;
+			info.height = height;
+			return;
+		}
 
-	free(temp_frames_array);
+		unsigned int x1 = info.x + info.width > x + width ? info.x + info.width : x + width;
+		unsigned int y1 = info.y + info.height > y + height ? info.y + info.height : y + height;
+		info.x			= info.x < x ? info.x : x;
+		info.y			= info.y < y ? info.y : y;
+		info.width		= x1 - info.x;
+		info.height		= y1 - info.y;
+	}
 
-	return err;
-}
+	//! byte offset of the first difference between a and b, size if equal
+	size_t first_mismatch(const uint8_t* a, const uint8_t* b, size_t size)
+	{
+		size_t i = 0;
+#ifdef APENG_SSE2
+		for (; i + 16 <= size; i += 16)
+		{
+			__m128i		 va   = _mm_loadu_si128((const __m128i*)(a + i));
+			__m128i		 vb   = _mm_loadu_si128((const __m128i*)(b + i));
+			unsigned int mask = ~(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) & 0xffffu;
+			if (mask != 0)
+			{
+				return i + lowest_bit_index(mask);
+			}
+		}
+#endif	// APENG_SSE2
+		for (; i < size; ++i)
+		{
+			if (a[i] != b[i])
+			{
+				return i;
+			}
+		}
+		return size;
+	}
 
+	//! byte offset of the last difference between a and b, size if equal
+	size_t last_mismatch(const uint8_t* a, const uint8_t* b, size_t size)
+	{
+		size_t i = size;
+#ifdef APENG_SSE2
+		for (; i >= 16; i -= 16)
+		{
+			__m128i		 va   = _mm_loadu_si128((const __m128i*)(a + i - 16));
+			__m128i		 vb   = _mm_loadu_si128((const __m128i*)(b + i - 16));
+			unsigned int mask = ~(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) & 0xffffu;
+			if (mask != 0)
+			{
+				return i - 16 + highest_bit_index(mask);
+			}
+		}
+#endif	// APENG_SSE2
+		for (; i > 0; --i)
+		{
+			if (a[i - 1] != b[i - 1])
+			{
+				return i - 1;
+			}
+		}
+		return size;
+	}
 
-//! apeng_load_frames_file_nt
-//! loads all frames into nullptr-terminated array of buffers
-//! all buffers and the returned array must be deleted using free()
-APENG_DLLIMPORT unsigned int APENG_API apeng_load_frames_file_nt(
-  FILE* file, uint8_t*** frames_array, unsigned int* width, unsigned int* height, unsigned int* channels, unsigned int* rowbytes)
-{
-	uint8_t**	temp_frames_array;
-	unsigned int frames;
-	unsigned int err = apeng_load_frames_file(file, &temp_frames_array, &frames, width, height, channels, rowbytes);
+	//! shrinks info's rectangle to the bounding box of the pixels differing between last and canvas
+	void rect_diff(apeng_frame_info& info, const uint8_t* last, const uint8_t* canvas, size_t rowbytes, unsigned int channels)
+	{
+		unsigned int x0 = info.x + info.width;
+		unsigned int x1 = info.x;
+		unsigned int y0 = info.y + info.height;
+		unsigned int y1 = info.y;
+
+		size_t offset = size_t(info.x) * channels;
+		size_t size   = size_t(info.width) * channels;
+		for (unsigned int rowIdx = info.y; rowIdx < info.y + info.height; ++rowIdx)
+		{
+			const uint8_t* a = last + rowIdx * rowbytes + offset;
+			const uint8_t* b = canvas + rowIdx * rowbytes + offset;
 
-	*frames_array = (uint8_t**)malloc((frames + 1) * sizeof(uint8_t*));
-	memset(*frames_array, 0, frames + 1);
-	memcpy(*frames_array, temp_frames_array, frames);
-	free(temp_frames_array);
+			size_t first = first_mismatch(a, b, size);
+			if (first == size)
+			{
+				continue;
+			}
+			size_t last_byte = last_mismatch(a, b, size);
+
+			unsigned int px0 = info.x + unsigned(first / channels);
+			unsigned int px1 = info.x + unsigned(last_byte / channels) + 1;
+			x0				 = px0 < x0 ? px0 : x0;
+			x1				 = px1 > x1 ? px1 : x1;
+			y0				 = rowIdx < y0 ? rowIdx : y0;
+			y1				 = rowIdx + 1;
+		}
 
-	return err;
-}
+		if (y1 <= y0)
+		{
+			info.x = info.y = info.width = info.height = 0;
+			return;
+		}
 
-//! apeng_load_frames_file
-//! loads all frames array of buffers
-//! all buffers and the returned array must be deleted using free()
-APENG_DLLIMPORT unsigned int APENG_API apeng_load_frames_file(FILE*			file,
-															  uint8_t***	frames_array,
-															  unsigned int* frames,
-															  unsigned int* width,
-															  unsigned int* height,
-															  unsigned int* channels,
-															  unsigned int* rowbytes)
-{
-	assert(file);
-	assert(frames_array);
-	assert(frames);
-	assert(width);
-	assert(height);
-	assert(channels);
-	assert(rowbytes);
+		info.x		= x0;
+		info.y		= y0;
+		info.width  = x1 - x0;
+		info.height = y1 - y0;
+	}
 
-	unsigned char sig[8];
-	if (!(fread(sig, 1, 8, file) == 8 && png_sig_cmp(sig, 0, 8) == 0))
+	//! composites src over dst, both BGRA with straight alpha
+	void blend_over(uint8_t* dst, const uint8_t* src, size_t pixels)
 	{
-		return (unsigned int)APENG_ERROR::data_invalid;
+		for (size_t i = 0; i < pixels; ++i, dst += 4, src += 4)
+		{
+			unsigned int src_a = src[3];
+			unsigned int dst_a = dst[3];
+			if (src_a == 0xff || dst_a == 0)
+			{
+				memcpy(dst, src, 4);
+			}
+			else if (src_a != 0)
+			{
+				unsigned int u = src_a * 0xff;
+				unsigned int v = (0xff - src_a) * dst_a;
+				unsigned int a = u + v;
+				dst[0]		   = uint8_t((src[0] * u + dst[0] * v) / a);
+				dst[1]		   = uint8_t((src[1] * u + dst[1] * v) / a);
+				dst[2]		   = uint8_t((src[2] * u + dst[2] * v) / a);
+				dst[3]		   = uint8_t(a / 0xff);
+			}
+		}
 	}
 
-	png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
-	assert(png_ptr);
-	png_infop info_ptr = png_create_info_struct(png_ptr);
-	assert(info_ptr);
-
-
-	if (png_ptr != nullptr && info_ptr != nullptr && setjmp(png_jmpbuf(png_ptr)) == 0)
+	//! box-filters the output rectangle [x0, x1) x [y0, y1) of dst from src, downscaled by factor
+	//!  edge boxes only average the source pixels they cover
+	void downscale_box(uint8_t*		  dst,
+					   size_t		  dst_rowbytes,
+					   const uint8_t* src,
+					   size_t		  src_rowbytes,
+					   unsigned int	  src_width,
+					   unsigned int	  src_height,
+					   unsigned int	  factor,
+					   unsigned int	  x0,
+					   unsigned int	  y0,
+					   unsigned int	  x1,
+					   unsigned int	  y1,
+					   uint32_t*	  sums)
 	{
-		png_init_io(png_ptr, file);
-		png_set_sig_bytes(png_ptr, 8);
-		png_read_info(png_ptr, info_ptr);
-		png_set_expand(png_ptr);
-		png_set_strip_16(png_ptr);
-		png_set_gray_to_rgb(png_ptr);
-		png_set_add_alpha(png_ptr, 0xff, PNG_FILLER_AFTER);
-		png_set_bgr(png_ptr);
-		(void)png_set_interlace_handling(png_ptr);
-		png_read_update_info(png_ptr, info_ptr);
-
-		*width				   = png_get_image_width(png_ptr, info_ptr);
-		*height				   = png_get_image_height(png_ptr, info_ptr);
-		*channels			   = png_get_channels(png_ptr, info_ptr);
-		*rowbytes			   = png_get_rowbytes(png_ptr, info_ptr);
-		unsigned int framesize = (*height) * (*rowbytes);
+		for (unsigned int y = y0; y < y1; ++y)
+		{
+			unsigned int sy0 = y * factor;
+			unsigned int sy1 = sy0 + factor < src_height ? sy0 + factor : src_height;
 
-		png_bytepp rows = (png_bytepp)malloc((*height) * sizeof(png_bytep));
-		assert(rows);
+			memset(sums, 0, size_t(x1 - x0) * 4 * sizeof(uint32_t));
+			for (unsigned int sy = sy0; sy < sy1; ++sy)
+			{
+				const uint8_t* row = src + sy * src_rowbytes;
+				uint32_t*	   sum = sums;
+				for (unsigned int x = x0; x < x1; ++x, sum += 4)
+				{
+					unsigned int sx0 = x * factor;
+					unsigned int sx1 = sx0 + factor < src_width ? sx0 + factor : src_width;
+#ifdef APENG_SSE2
+					//! all four channels of a pixel in one register
+					__m128i		 acc  = _mm_loadu_si128((const __m128i*)sum);
+					const __m128i zero = _mm_setzero_si128();
+					for (unsigned int sx = sx0; sx < sx1; ++sx)
+					{
+						int		px;
+						memcpy(&px, row + sx * 4, 4);
+						__m128i v = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(px), zero), zero);
+						acc		  = _mm_add_epi32(acc, v);
+					}
+					_mm_storeu_si128((__m128i*)sum, acc);
+#else
+					for (unsigned int sx = sx0; sx < sx1; ++sx)
+					{
+						sum[0] += row[sx * 4 + 0];
+						sum[1] += row[sx * 4 + 1];
+						sum[2] += row[sx * 4 + 2];
+						sum[3] += row[sx * 4 + 3];
+					}
+#endif	// APENG_SSE2
+				}
+			}
 
-		*frames		   = 1;
-		png_uint_32 w0 = *width;
-		png_uint_32 h0 = *height;
+			uint8_t*		out = dst + y * dst_rowbytes + size_t(x0) * 4;
+			const uint32_t* sum = sums;
+			for (unsigned int x = x0; x < x1; ++x, sum += 4, out += 4)
+			{
+				unsigned int sx0   = x * factor;
+				unsigned int sx1   = sx0 + factor < src_width ? sx0 + factor : src_width;
+				uint32_t	 count = (sx1 - sx0) * (sy1 - sy0);
+				out[0]			   = uint8_t((sum[0] + count / 2) / count);
+				out[1]			   = uint8_t((sum[1] + count / 2) / count);
+				out[2]			   = uint8_t((sum[2] + count / 2) / count);
+				out[3]			   = uint8_t((sum[3] + count / 2) / count);
+			}
+		}
+	}
 
-#ifdef PNG_APNG_SUPPORTED
-		png_uint_32 plays = 0;
-		png_uint_32 x0	= 0;
-		png_uint_32 y0	= 0;
+	//! marks the animation frames selected by options in keep, returns their number
+	unsigned int select_frames(uint8_t* keep, unsigned int frames, const apeng_decode_options* options)
+	{
+		unsigned int selected = 0;
+		for (unsigned int frameIdx = 0; frameIdx < frames; ++frameIdx)
+		{
+			keep[frameIdx] = options == nullptr || options->frame_step <= 1 || frameIdx % options->frame_step == 0;
+		}
 
-		unsigned short delay_num = 1;
-		unsigned short delay_den = 10;
-		unsigned char  displayOp = 0;
-		unsigned char  blendOp   = 0;
+		if (options != nullptr && options->frame_indices != nullptr)
+		{
+			memset(keep, 0, frames);
+			for (unsigned int i = 0; i < options->frame_index_count; ++i)
+			{
+				if (options->frame_indices[i] < frames)
+				{
+					keep[options->frame_indices[i]] = 1;
+				}
+			}
+		}
 
-		if (png_get_valid(png_ptr, info_ptr, PNG_INFO_acTL))
+		for (unsigned int frameIdx = 0; frameIdx < frames; ++frameIdx)
 		{
-			png_get_acTL(png_ptr, info_ptr, frames, &plays);
+			selected += keep[frameIdx];
 		}
-#endif
+		return selected;
+	}
 
-		*frames_array = (uint8_t**)malloc(*frames * sizeof(uint8_t*));
+	//! prefetches a file on a separate thread into a ring of fixed-size blocks
+	//! rationale: libpng otherwise reads on the decoding thread, stalling inflate on every cold read
+	class readahead_reader
+	{
+	public:
+		static constexpr size_t		  block_alignment = 4096;
+		static constexpr size_t		  block_size_max  = size_t(16) << 20;
+		static constexpr unsigned int depth_max		  = 16;
+
+		//! returns null if the buffers or the thread cannot be allocated
+		//!  rationale: exceptions must not escape through the C API
+		static std::unique_ptr<readahead_reader> create(FILE* file, size_t block_size, unsigned int depth)
+		{
+			try
+			{
+				return std::unique_ptr<readahead_reader>(new readahead_reader(file, block_size, depth));
+			}
+			catch (const std::exception&)
+			{
+				return nullptr;
+			}
+		}
 
-		for (unsigned int frameIdx = 0; frameIdx < *frames; ++frameIdx)
+		readahead_reader(FILE* file, size_t block_size, unsigned int depth)
+		  : file_(file)
+		  , block_size_(((block_size < block_size_max ? block_size : block_size_max) + block_alignment - 1)
+						/ block_alignment * block_alignment)
+		  , blocks_(depth < 2 ? 2 : depth < depth_max ? depth : depth_max)
+		  , sizes_(blocks_.size(), 0)
 		{
-			(*frames_array)[frameIdx] = (uint8_t*)malloc(framesize);
+			for (std::vector<uint8_t>& block : blocks_)
+			{
+				block.resize(block_size_);
+			}
+			thread_ = std::thread(&readahead_reader::run, this);
+		}
 
-			for (unsigned rowIdx = 0; rowIdx < *height; ++rowIdx)
+		~readahead_reader()
+		{
 			{
-				rows[rowIdx] = (*frames_array)[frameIdx] + (rowIdx * (*rowbytes));
+				std::lock_guard<std::mutex> lock(mutex_);
+				stop_ = true;
 			}
+			filled_cond_.notify_all();
+			free_cond_.notify_all();
+			thread_.join();
+		}
 
-#ifdef PNG_APNG_SUPPORTED
-			if (png_get_valid(png_ptr, info_ptr, PNG_INFO_acTL))
+		//! copies up to size bytes to out, blocking until they are read
+		//!  returns fewer bytes only at the end of the file or on a read error
+		size_t read(uint8_t* out, size_t size)
+		{
+			size_t copied = 0;
+			while (copied < size)
 			{
-				png_read_frame_head(png_ptr, info_ptr);
-				png_get_next_frame_fcTL(png_ptr, info_ptr, &w0, &h0, &x0, &y0, &delay_num, &delay_den, &displayOp, &blendOp);
+				if (offset_ == current_size_)
+				{
+					if (!next_block())
+					{
+						break;
+					}
+					continue;
+				}
+
+				size_t count = std::min(size - copied, current_size_ - offset_);
+				memcpy(out + copied, blocks_[head_].data() + offset_, count);
+				offset_ += count;
+				copied += count;
 			}
-#endif
+			return copied;
+		}
 
-			png_read_image(png_ptr, rows);
+		static void PNGAPI png_read(png_structp png_ptr, png_bytep data, png_size_t length)
+		{
+			readahead_reader* reader = static_cast<readahead_reader*>(png_get_io_ptr(png_ptr));
+			if (reader->read(data, length) != length)
+			{
+				png_error(png_ptr, "Read Error");
+			}
 		}
 
-		png_read_end(png_ptr, info_ptr);
-		free(rows);
-	}
+	private:
+		//! releases the consumed block at head_ and waits for the next one
+		bool next_block()
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			if (has_current_)
+			{
+				has_current_ = false;
+				head_		 = (head_ + 1) % blocks_.size();
+				--filled_;
+				free_cond_.notify_one();
+			}
+			filled_cond_.wait(lock, [this] { return filled_ > 0 || done_; });
+			if (filled_ == 0)
+			{
+				return false;
+			}
 
-	png_destroy_read_struct(&png_ptr, &info_ptr, nullptr);
+			has_current_  = true;
+			current_size_ = sizes_[head_];
+			offset_		  = 0;
+			return true;
+		}
 
-	return (unsigned int)APENG_ERROR::no_error;
-}
+		void run()
+		{
+			//! the first read ends on a block boundary so the following ones stay aligned
+			long   position = ftell(file_);
+			size_t request	= position > 0 ? block_size_ - size_t(position) % block_size_ : block_size_;
+			size_t tail		= 0;
 
+			for (;;)
+			{
+				{
+					std::unique_lock<std::mutex> lock(mutex_);
+					free_cond_.wait(lock, [this] { return filled_ < blocks_.size() || stop_; });
+					if (stop_)
+					{
+						break;
+					}
+					tail = (head_ + filled_) % blocks_.size();
+				}
+
+				//! the block at tail belongs to this thread until filled_ covers it
+				size_t count = fread(blocks_[tail].data(), 1, request, file_);
+
+				std::lock_guard<std::mutex> lock(mutex_);
+				if (count > 0)
+				{
+					sizes_[tail] = count;
+					++filled_;
+				}
+				if (count < request)
+				{
+					break;
+				}
+				filled_cond_.notify_one();
+				request = block_size_;
+			}
 
-//! apeng_load_frames_blob
-//! loads all frames into large buffer frame_blob
-//!  frame_blob must be deleted by user using free()
-APENG_DLLIMPORT unsigned int APENG_API apeng_load_frames_blob(const char*   filename,
-															  uint8_t**		frames_blob,
-															  unsigned int* frames_blob_size,
-															  unsigned int* width,
-															  unsigned int* height,
-															  unsigned int* channels,
-															  unsigned int* rowbytes,
-															  unsigned int* frames)
-{
-	std::shared_ptr<FILE> file(fopen(filename, "rb"), fclose);
+			std::lock_guard<std::mutex> lock(mutex_);
+			done_ = true;
+			filled_cond_.notify_one();
+		}
+
+		FILE*							  file_;
+		size_t							  block_size_;
+		std::vector<std::vector<uint8_t>> blocks_;
+		std::vector<size_t>				  sizes_;
+		std::thread						  thread_;
+
+		std::mutex				mutex_;
+		std::condition_variable filled_cond_;	//! signaled when a block is read or the reader is done
+		std::condition_variable free_cond_;		//! signaled when a block is consumed or on stop
+		size_t					head_   = 0;	//! oldest unconsumed block
+		size_t					filled_ = 0;	//! blocks read and not yet consumed, starting at head_
+		bool					done_   = false;
+		bool					stop_   = false;
+
+		//! consumer-side state, only touched by read()
+		bool   has_current_  = false;
+		size_t current_size_ = 0;
+		size_t offset_		 = 0;
+	};
+
+	unsigned int decode_frames_png(png_structp				   png_ptr,
+								   png_infop				   info_ptr,
+								   FILE*					   file,
+								   frame_receiver&			   receiver,
+								   unsigned int				   dirty_rect_mode,
+								   const apeng_decode_options* options,
+								   decode_state&			   state,
+								   readahead_reader*		   reader)
+	{
+		if (reader != nullptr)
+		{
+			png_set_read_fn(png_ptr, reader, &readahead_reader::png_read);
+		}
+		else
+		{
+			png_init_io(png_ptr, file);
+		}
+		png_set_sig_bytes(png_ptr, 8);
+		png_read_info(png_ptr, info_ptr);
+		png_set_expand(png_ptr);
+		png_set_strip_16(png_ptr);
+		png_set_gray_to_rgb(png_ptr);
+		png_set_add_alpha(png_ptr, 0xff, PNG_FILLER_AFTER);
+		png_set_bgr(png_ptr);
+		(void)png_set_interlace_handling(png_ptr);
+		png_read_update_info(png_ptr, info_ptr);
+
+		unsigned int width	= png_get_image_width(png_ptr, info_ptr);
+		unsigned int height   = png_get_image_height(png_ptr, info_ptr);
+		unsigned int channels = png_get_channels(png_ptr, info_ptr);
+		size_t		 rowbytes = png_get_rowbytes(png_ptr, info_ptr);
+		assert(channels == 4);
+
+		bool		 poster = options != nullptr && options->poster_only != 0;
+		unsigned int factor = options != nullptr && options->downscale > 1 ? options->downscale : 1;
+
+		frames_header header;
+		header.frames	= 1;
+		header.width	= (width + factor - 1) / factor;
+		header.height   = (height + factor - 1) / factor;
+		header.channels = channels;
+		header.rowbytes = size_t(header.width) * channels;
+
+		size_t framesize;
+		size_t scaledsize;
+		if (!checked_mul(height, rowbytes, framesize) || !checked_mul(header.height, header.rowbytes, scaledsize))
+		{
+			return (unsigned int)APENG_ERROR::size_overflow;
+		}
+
+		bool		animated = false;
+		bool		hidden   = false;
+		png_uint_32 frames   = 1;
+
+#ifdef PNG_APNG_SUPPORTED
+		if (png_get_valid(png_ptr, info_ptr, PNG_INFO_acTL))
+		{
+			png_uint_32 plays = 0;
+			png_get_acTL(png_ptr, info_ptr, &frames, &plays);
+			animated = true;
+			hidden   = png_get_first_frame_is_hidden(png_ptr, info_ptr) != 0;
+		}
+#endif	// PNG_APNG_SUPPORTED
+
+		//! acTL counts the animation frames only; a hidden default image precedes them
+		//!  the poster frame is the default image, whether or not it is part of the animation
+		unsigned int animation_frames = poster ? 1 : frames;
+		hidden						  = hidden && !poster;
+		png_uint_32 images			  = frames + (hidden ? 1 : 0);
+
+		state.keep = (uint8_t*)malloc(animation_frames > 0 ? animation_frames : 1);
+		if (!state.keep)
+		{
+			return (unsigned int)APENG_ERROR::out_of_memory;
+		}
+		header.frames = poster ? 1 : select_frames(state.keep, animation_frames, options);
+		state.keep[0] = poster ? 1 : state.keep[0];
+
+		unsigned int err = receiver.begin(header);
+		if (err != (unsigned int)APENG_ERROR::no_error || header.frames == 0)
+		{
+			return err;
+		}
+
+		state.rows	 = (png_bytepp)malloc(height * sizeof(png_bytep));
+		state.canvas   = (uint8_t*)calloc(framesize, 1);
+		state.frame	= (uint8_t*)malloc(framesize);
+		state.previous = (uint8_t*)malloc(framesize);
+		state.last	 = dirty_rect_mode == APENG_DIRTY_RECT_DIFF ? (uint8_t*)malloc(framesize) : nullptr;
+		state.scaled   = factor > 1 ? (uint8_t*)malloc(scaledsize) : nullptr;
+		state.sums	 = factor > 1 ? (uint32_t*)malloc(size_t(header.width) * 4 * sizeof(uint32_t)) : nullptr;
+		if (!state.rows || !state.canvas || !state.frame || !state.previous
+			|| (dirty_rect_mode == APENG_DIRTY_RECT_DIFF && !state.last) || (factor > 1 && (!state.scaled || !state.sums)))
+		{
+			return (unsigned int)APENG_ERROR::out_of_memory;
+		}
+
+		//! region changed since the last output frame
+		apeng_frame_info dirty  = {0, 0, width, height, 0, 0};
+		unsigned int	 animIdx  = 0;
+		unsigned int	 outIdx   = 0;
+		png_uint_32		 frameIdx = 0;
+
+		for (; frameIdx < images && outIdx < header.frames; ++frameIdx)
+		{
+			png_uint_32 w0		   = width;
+			png_uint_32 h0		   = height;
+			png_uint_32 x0		   = 0;
+			png_uint_32 y0		   = 0;
+			png_uint_16 delay_num  = 1;
+			png_uint_16 delay_den  = 10;
+			png_byte	dispose_op = PNG_DISPOSE_OP_NONE;
+			png_byte	blend_op   = PNG_BLEND_OP_SOURCE;
+
+#ifdef PNG_APNG_SUPPORTED
+			if (animated)
+			{
+				png_read_frame_head(png_ptr, info_ptr);
+				if (png_get_valid(png_ptr, info_ptr, PNG_INFO_fcTL))
+				{
+					png_get_next_frame_fcTL(
+					  png_ptr, info_ptr, &w0, &h0, &x0, &y0, &delay_num, &delay_den, &dispose_op, &blend_op);
+				}
+			}
+#endif	// PNG_APNG_SUPPORTED
+
+			if (w0 > width || h0 > height || x0 > width - w0 || y0 > height - h0)
+			{
+				return (unsigned int)APENG_ERROR::data_invalid;
+			}
+
+			size_t frame_rowbytes = size_t(w0) * channels;
+			for (png_uint_32 rowIdx = 0; rowIdx < h0; ++rowIdx)
+			{
+				state.rows[rowIdx] = state.frame + rowIdx * frame_rowbytes;
+			}
+
+			png_read_image(png_ptr, state.rows);
+
+			//! the hidden default image is not part of the animation
+			if (hidden && frameIdx == 0)
+			{
+				continue;
+			}
+
+			if (animIdx == 0)
+			{
+				blend_op = PNG_BLEND_OP_SOURCE;
+				if (dispose_op == PNG_DISPOSE_OP_PREVIOUS)
+				{
+					dispose_op = PNG_DISPOSE_OP_BACKGROUND;
+				}
+			}
+
+			size_t offset = size_t(x0) * channels;
+			for (png_uint_32 rowIdx = 0; rowIdx < h0; ++rowIdx)
+			{
+				uint8_t*	   dst = state.canvas + (y0 + rowIdx) * rowbytes + offset;
+				const uint8_t* src = state.rows[rowIdx];
+
+				if (dispose_op == PNG_DISPOSE_OP_PREVIOUS)
+				{
+					memcpy(state.previous + rowIdx * frame_rowbytes, dst, frame_rowbytes);
+				}
+
+				if (blend_op == PNG_BLEND_OP_OVER)
+				{
+					blend_over(dst, src, w0);
+				}
+				else
+				{
+					memcpy(dst, src, frame_rowbytes);
+				}
+			}
+
+			rect_union(dirty, x0, y0, w0, h0);
+
+			if (state.keep[animIdx])
+			{
+				apeng_frame_info info = dirty;
+				info.delay_num		  = delay_num;
+				info.delay_den		  = delay_den;
+
+				if (state.last)
+				{
+					if (outIdx > 0)
+					{
+						rect_diff(info, state.last, state.canvas, rowbytes, channels);
+					}
+					memcpy(state.last, state.canvas, framesize);
+				}
+
+				const uint8_t* output = state.canvas;
+				if (factor > 1)
+				{
+					//! only the dirty region of the downscaled frame needs refreshing
+					unsigned int sx0 = info.x / factor;
+					unsigned int sy0 = info.y / factor;
+					unsigned int sx1 = (info.x + info.width + factor - 1) / factor;
+					unsigned int sy1 = (info.y + info.height + factor - 1) / factor;
+					downscale_box(state.scaled,
+								  header.rowbytes,
+								  state.canvas,
+								  rowbytes,
+								  width,
+								  height,
+								  factor,
+								  sx0,
+								  sy0,
+								  sx1,
+								  sy1,
+								  state.sums);
+
+					info.x		= sx0;
+					info.y		= sy0;
+					info.width  = info.width > 0 ? sx1 - sx0 : 0;
+					info.height = info.height > 0 ? sy1 - sy0 : 0;
+					output		= state.scaled;
+				}
+
+				err = receiver.frame(outIdx, output, info);
+				if (err != (unsigned int)APENG_ERROR::no_error)
+				{
+					return err;
+				}
+				++outIdx;
+
+				dirty.width = dirty.height = 0;
+			}
+			++animIdx;
+
+			if (dispose_op != PNG_DISPOSE_OP_NONE)
+			{
+				for (png_uint_32 rowIdx = 0; rowIdx < h0; ++rowIdx)
+				{
+					uint8_t* dst = state.canvas + (y0 + rowIdx) * rowbytes + offset;
+					if (dispose_op == PNG_DISPOSE_OP_PREVIOUS)
+					{
+						memcpy(dst, state.previous + rowIdx * frame_rowbytes, frame_rowbytes);
+					}
+					else
+					{
+						memset(dst, 0, frame_rowbytes);
+					}
+				}
+				rect_union(dirty, x0, y0, w0, h0);
+			}
+		}
+
+		//! stopping after the last selected frame skips the rest of the file
+		if (frameIdx == images)
+		{
+			png_read_end(png_ptr, info_ptr);
+		}
+
+		return (unsigned int)APENG_ERROR::no_error;
+	}
+
+	//! runs decode_frames_png() under setjmp(), returning data_invalid after a libpng error
+	//!  rationale: no local of the caller is assigned between setjmp() and longjmp(), so none can be clobbered
+	unsigned int decode_frames_jmp(png_structp				   png_ptr,
+								   png_infop				   info_ptr,
+								   FILE*					   file,
+								   frame_receiver&			   receiver,
+								   unsigned int				   dirty_rect_mode,
+								   const apeng_decode_options* options,
+								   decode_state&			   state,
+								   readahead_reader*		   reader)
+	{
+		if (setjmp(png_jmpbuf(png_ptr)) != 0)
+		{
+			return (unsigned int)APENG_ERROR::data_invalid;
+		}
+		return decode_frames_png(png_ptr, info_ptr, file, receiver, dirty_rect_mode, options, state, reader);
+	}
+
+	//! decodes and composites the frames of file selected by options (may be null), passing them to receiver
+	unsigned int decode_frames(FILE*					   file,
+							   frame_receiver&			   receiver,
+							   unsigned int				   dirty_rect_mode,
+							   const apeng_decode_options* options)
+	{
+		assert(file);
+
+		unsigned char sig[8];
+		if (!(fread(sig, 1, 8, file) == 8 && png_sig_cmp(sig, 0, 8) == 0))
+		{
+			return (unsigned int)APENG_ERROR::data_invalid;
+		}
+
+		//! created outside the setjmp() frame so the reader thread is joined after a libpng error
+		std::unique_ptr<readahead_reader> reader;
+		if (options != nullptr && options->readahead_block_size > 0)
+		{
+			reader = readahead_reader::create(file, options->readahead_block_size, options->readahead_depth);
+			if (!reader)
+			{
+				return (unsigned int)APENG_ERROR::out_of_memory;
+			}
+		}
+
+		png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+		assert(png_ptr);
+		png_infop info_ptr = png_create_info_struct(png_ptr);
+		assert(info_ptr);
+
+		decode_state state = {nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr};
+		unsigned int err   = (unsigned int)APENG_ERROR::data_invalid;
+		if (png_ptr != nullptr && info_ptr != nullptr)
+		{
+			err = decode_frames_jmp(png_ptr, info_ptr, file, receiver, dirty_rect_mode, options, state, reader.get());
+		}
+
+		png_destroy_read_struct(&png_ptr, &info_ptr, nullptr);
+		reader.reset();
+
+		free(state.rows);
+		free(state.canvas);
+		free(state.frame);
+		free(state.previous);
+		free(state.last);
+		free(state.scaled);
+		free(state.sums);
+		free(state.keep);
+
+		return err;
+	}
+
+	//! stores frames into a malloc()'d array of buffers
+	class array_receiver : public frame_receiver
+	{
+	public:
+		array_receiver(uint8_t***		  frames_array,
+					   apeng_frame_info** frames_info,
+					   unsigned int*	  frames,
+					   unsigned int*	  width,
+					   unsigned int*	  height,
+					   unsigned int*	  channels,
+					   unsigned int*	  rowbytes)
+		  : frames_array(frames_array)
+		  , frames_info(frames_info)
+		  , frames(frames)
+		  , width(width)
+		  , height(height)
+		  , channels(channels)
+		  , rowbytes(rowbytes)
+		  , framesize(0)
+		{
+			//! errors before begin() must not leave stale pointers for the caller to free()
+			*frames_array = nullptr;
+			*frames		  = 0;
+			if (frames_info)
+			{
+				*frames_info = nullptr;
+			}
+		}
+
+		unsigned int begin(const frames_header& header) override
+		{
+			if (header.rowbytes > UINT_MAX)
+			{
+				return (unsigned int)APENG_ERROR::size_overflow;
+			}
+
+			*frames   = header.frames;
+			*width	= header.width;
+			*height   = header.height;
+			*channels = header.channels;
+			*rowbytes = (unsigned int)header.rowbytes;
+			framesize = header.height * header.rowbytes;
+
+			*frames_array = (uint8_t**)calloc(header.frames, sizeof(uint8_t*));
+			if (frames_info)
+			{
+				*frames_info = (apeng_frame_info*)calloc(header.frames, sizeof(apeng_frame_info));
+			}
+			if (!*frames_array || (frames_info && !*frames_info))
+			{
+				return (unsigned int)APENG_ERROR::out_of_memory;
+			}
+			return (unsigned int)APENG_ERROR::no_error;
+		}
+
+		unsigned int frame(unsigned int frameIdx, const uint8_t* canvas, const apeng_frame_info& info) override
+		{
+			(*frames_array)[frameIdx] = (uint8_t*)malloc(framesize);
+			if (!(*frames_array)[frameIdx])
+			{
+				return (unsigned int)APENG_ERROR::out_of_memory;
+			}
+			memcpy((*frames_array)[frameIdx], canvas, framesize);
+			if (frames_info)
+			{
+				(*frames_info)[frameIdx] = info;
+			}
+			return (unsigned int)APENG_ERROR::no_error;
+		}
+
+		//! frees everything handed out so far, so a failed load returns null outputs
+		void discard()
+		{
+			for (unsigned int frameIdx = 0; *frames_array && frameIdx < *frames; ++frameIdx)
+			{
+				free((*frames_array)[frameIdx]);
+			}
+			free(*frames_array);
+			*frames_array = nullptr;
+			*frames		  = 0;
+			if (frames_info)
+			{
+				free(*frames_info);
+				*frames_info = nullptr;
+			}
+		}
+
+	private:
+		uint8_t***		   frames_array;
+		apeng_frame_info** frames_info;
+		unsigned int*	  frames;
+		unsigned int*	  width;
+		unsigned int*	  height;
+		unsigned int*	  channels;
+		unsigned int*	  rowbytes;
+		size_t			   framesize;
+	};
+
+	//! stores frames back-to-back into one malloc()'d buffer
+	//!  blob and row sizes above size_limit fail with size_overflow before anything is allocated
+	class blob_receiver : public frame_receiver
+	{
+	public:
+		blob_receiver(uint8_t**		frames_blob,
+					  size_t*		frames_blob_size,
+					  unsigned int* width,
+					  unsigned int* height,
+					  unsigned int* channels,
+					  size_t*		rowbytes,
+					  unsigned int* frames,
+					  size_t		size_limit)
+		  : frames_blob(frames_blob)
+		  , frames_blob_size(frames_blob_size)
+		  , width(width)
+		  , height(height)
+		  , channels(channels)
+		  , rowbytes(rowbytes)
+		  , frames(frames)
+		  , framesize(0)
+		  , size_limit(size_limit)
+		{
+		}
+
+		unsigned int begin(const frames_header& header) override
+		{
+			framesize = header.height * header.rowbytes;
+
+			size_t blobsize;
+			if (!checked_mul(framesize, header.frames, blobsize) || blobsize > size_limit || header.rowbytes > size_limit)
+			{
+				return (unsigned int)APENG_ERROR::size_overflow;
+			}
+
+			*frames_blob_size = blobsize;
+			*width			  = header.width;
+			*height			  = header.height;
+			*channels		  = header.channels;
+			*rowbytes		  = header.rowbytes;
+			*frames			  = header.frames;
+
+			*frames_blob = (uint8_t*)malloc(blobsize);
+			if (!*frames_blob && blobsize > 0)
+			{
+				return (unsigned int)APENG_ERROR::out_of_memory;
+			}
+			return (unsigned int)APENG_ERROR::no_error;
+		}
+
+		unsigned int frame(unsigned int frameIdx, const uint8_t* canvas, const apeng_frame_info&) override
+		{
+			memcpy(*frames_blob + frameIdx * framesize, canvas, framesize);
+			return (unsigned int)APENG_ERROR::no_error;
+		}
+
+		//! frees the blob, so a failed load returns a null output
+		void discard()
+		{
+			free(*frames_blob);
+			*frames_blob = nullptr;
+		}
+
+	private:
+		uint8_t**	 frames_blob;
+		size_t*		  frames_blob_size;
+		unsigned int* width;
+		unsigned int* height;
+		unsigned int* channels;
+		size_t*		  rowbytes;
+		unsigned int* frames;
+		size_t		  framesize;
+		size_t		  size_limit;
+	};
+}	// namespace
+
+
+//! apeng_load_frames_file_blob
+//! loads all frames into large buffer frame_blob
+//!  frame_blob must be deleted by user using free()
+APENG_DLLIMPORT unsigned int APENG_API apeng_load_frames_file_blob(FILE*		 file,
+																   uint8_t**	 frames_blob,
+																   unsigned int* frames_blob_size,
+																   unsigned int* width,
+																   unsigned int* height,
+																   unsigned int* channels,
+																   unsigned int* rowbytes,
+																   unsigned int* frames)
+{
 	assert(file);
-	return apeng_load_frames_file_blob(file.get(), frames_blob, frames_blob_size, width, height, channels, rowbytes, frames);
+	assert(frames_blob);
+	assert(frames_blob_size);
+	assert(width);
+	assert(height);
+	assert(channels);
+	assert(rowbytes);
+	assert(frames);
+
+	*frames_blob = nullptr;
+
+	//! the 32-bit sizes are checked before the blob is allocated
+	size_t		  blob_size;
+	size_t		  row_size;
+	blob_receiver receiver(frames_blob, &blob_size, width, height, channels, &row_size, frames, UINT_MAX);
+	unsigned int  err = decode_frames(file, receiver, APENG_DIRTY_RECT_FCTL, nullptr);
+	if (err != (unsigned int)APENG_ERROR::no_error)
+	{
+		receiver.discard();
+		return err;
+	}
+
+	*frames_blob_size = (unsigned int)blob_size;
+	*rowbytes		  = (unsigned int)row_size;
+
+	return err;
 }
 
 
-//! apeng_load_frames_nt
+//! apeng_load_frames_file_blob64
+//! loads all frames into large buffer frame_blob, with 64-bit sizes
+//!  frame_blob must be deleted by user using free()
+APENG_DLLIMPORT unsigned int APENG_API apeng_load_frames_file_blob64(FILE*		 file,
+																	 uint8_t**	 frames_blob,
+																	 size_t*	   frames_blob_size,
+																	 unsigned int* width,
+																	 unsigned int* height,
+																	 unsigned int* channels,
+																	 size_t*	   rowbytes,
+																	 unsigned int* frames)
+{
+	assert(file);
+	assert(frames_blob);
+	assert(frames_blob_size);
+	assert(width);
+	assert(height);
+	assert(channels);
+	assert(rowbytes);
+	assert(frames);
+
+	*frames_blob = nullptr;
+
+	blob_receiver receiver(frames_blob, frames_blob_size, width, height, channels, rowbytes, frames, SIZE_MAX);
+	unsigned int  err = decode_frames(file, receiver, APENG_DIRTY_RECT_FCTL, nullptr);
+	if (err != (unsigned int)APENG_ERROR::no_error)
+	{
+		receiver.discard();
+	}
+	return err;
+}
+
+
+//! apeng_load_frames_file_nt
 //! loads all frames into nullptr-terminated array of buffers
 //! all buffers and the returned array must be deleted using free()
-APENG_DLLIMPORT unsigned int APENG_API apeng_load_frames_nt(
-  const char* filename, uint8_t*** frames_array, unsigned int* width, unsigned int* height, unsigned int* channels, unsigned int* rowbytes)
+APENG_DLLIMPORT unsigned int APENG_API apeng_load_frames_file_nt(
+  FILE* file, uint8_t*** frames_array, unsigned int* width, unsigned int* height, unsigned int* channels, unsigned int* rowbytes)
 {
-	std::shared_ptr<FILE> file(fopen(filename, "rb"), fclose);
-	assert(file);
-	return apeng_load_frames_file_nt(file.get(), frames_array, width, height, channels, rowbytes);
+	uint8_t**	temp_frames_array = nullptr;
+	unsigned int frames			   = 0;
+	unsigned int err			   = apeng_load_frames_file(file, &temp_frames_array, &frames, width, height, channels, rowbytes);
+
+	if (err != (unsigned int)APENG_ERROR::no_error)
+	{
+		*frames_array = nullptr;
+		return err;
+	}
+
+	*frames_array = (uint8_t**)realloc(temp_frames_array, (frames + size_t(1)) * sizeof(uint8_t*));
+	if (!*frames_array)
+	{
+		for (unsigned int frameIdx = 0; frameIdx < frames; ++frameIdx)
+		{
+			free(temp_frames_array[frameIdx]);
+		}
+		free(temp_frames_array);
+		return (unsigned int)APENG_ERROR::out_of_memory;
+	}
+	(*frames_array)[frames] = nullptr;
+
+	return err;
 }
 
-//! apeng_load_frames
+//! apeng_load_frames_file
 //! loads all frames array of buffers
 //! all buffers and the returned array must be deleted using free()
-APENG_DLLIMPORT unsigned int APENG_API apeng_load_frames(const char*   filename,
-														 uint8_t***	frames_array,
-														 unsigned int* frames,
-														 unsigned int* width,
-														 unsigned int* height,
-														 unsigned int* channels,
-														 unsigned int* rowbytes)
+APENG_DLLIMPORT unsigned int APENG_API apeng_load_frames_file(FILE*			file,
+															  uint8_t***	frames_array,
+															  unsigned int* frames,
+															  unsigned int* width,
+															  unsigned int* height,
+															  unsigned int* channels,
+															  unsigned int* rowbytes)
+{
+	return apeng_load_frames_file_info(
+	  file, frames_array, nullptr, frames, width, height, channels, rowbytes, APENG_DIRTY_RECT_FCTL);
+}
+
+
+//! apeng_load_frames_file_info
+//! loads all frames array of buffers, along with per-frame info
+//!  dirty_rect_mode is one of apeng_dirty_rect_mode
+//! all buffers and the returned arrays must be deleted using free()
+APENG_DLLIMPORT unsigned int APENG_API apeng_load_frames_file_info(FILE*			   file,
+																   uint8_t***		   frames_array,
+																   apeng_frame_info** frames_info,
+																   unsigned int*	   frames,
+																   unsigned int*	   width,
+																   unsigned int*	   height,
+																   unsigned int*	   channels,
+																   unsigned int*	   rowbytes,
+																   unsigned int	   dirty_rect_mode)
+{
+	assert(file);
+	assert(frames_array);
+	assert(frames);
+	assert(width);
+	assert(height);
+	assert(channels);
+	assert(rowbytes);
+
+	array_receiver receiver(frames_array, frames_info, frames, width, height, channels, rowbytes);
+	unsigned int   err = decode_frames(file, receiver, dirty_rect_mode, nullptr);
+	if (err != (unsigned int)APENG_ERROR::no_error)
+	{
+		receiver.discard();
+	}
+	return err;
+}
+
+
+//! apeng_load_frames_file_opts
+//! loads the frames selected by options into an array of buffers, along with per-frame info
+//!  frames_info may be null, dirty rectangles are relative to the previous loaded frame
+//! all buffers and the returned arrays must be deleted using free()
+APENG_DLLIMPORT unsigned int APENG_API apeng_load_frames_file_opts(FILE*						file,
+																   const apeng_decode_options* options,
+																   uint8_t***					frames_array,
+																   apeng_frame_info**			frames_info,
+																   unsigned int*				frames,
+																   unsigned int*				width,
+																   unsigned int*				height,
+																   unsigned int*				channels,
+																   unsigned int*				rowbytes,
+																   unsigned int				dirty_rect_mode)
+{
+	assert(file);
+	assert(frames_array);
+	assert(frames);
+	assert(width);
+	assert(height);
+	assert(channels);
+	assert(rowbytes);
+
+	array_receiver receiver(frames_array, frames_info, frames, width, height, channels, rowbytes);
+	unsigned int   err = decode_frames(file, receiver, dirty_rect_mode, options);
+	if (err != (unsigned int)APENG_ERROR::no_error)
+	{
+		receiver.discard();
+	}
+	return err;
+}
+
+
+//! apeng_load_frames_blob
+//! loads all frames into large buffer frame_blob
+//!  frame_blob must be deleted by user using free()
+APENG_DLLIMPORT unsigned int APENG_API apeng_load_frames_blob(const char*   filename,
+															  uint8_t**		frames_blob,
+															  unsigned int* frames_blob_size,
+															  unsigned int* width,
+															  unsigned int* height,
+															  unsigned int* channels,
+															  unsigned int* rowbytes,
+															  unsigned int* frames)
+{
+	std::shared_ptr<FILE> file(fopen(filename, "rb"), fclose);
+	assert(file);
+	return apeng_load_frames_file_blob(file.get(), frames_blob, frames_blob_size, width, height, channels, rowbytes, frames);
+}
+
+
+//! apeng_load_frames_blob64
+//! loads all frames into large buffer frame_blob, with 64-bit sizes
+//!  frame_blob must be deleted by user using free()
+APENG_DLLIMPORT unsigned int APENG_API apeng_load_frames_blob64(const char*   filename,
+																uint8_t**	 frames_blob,
+																size_t*		  frames_blob_size,
+																unsigned int* width,
+																unsigned int* height,
+																unsigned int* channels,
+																size_t*		  rowbytes,
+																unsigned int* frames)
+{
+	std::shared_ptr<FILE> file(fopen(filename, "rb"), fclose);
+	assert(file);
+	return apeng_load_frames_file_blob64(file.get(), frames_blob, frames_blob_size, width, height, channels, rowbytes, frames);
+}
+
+
+//! apeng_load_frames_nt
+//! loads all frames into nullptr-terminated array of buffers
+//! all buffers and the returned array must be deleted using free()
+APENG_DLLIMPORT unsigned int APENG_API apeng_load_frames_nt(
+  const char* filename, uint8_t*** frames_array, unsigned int* width, unsigned int* height, unsigned int* channels, unsigned int* rowbytes)
+{
+	std::shared_ptr<FILE> file(fopen(filename, "rb"), fclose);
+	assert(file);
+	return apeng_load_frames_file_nt(file.get(), frames_array, width, height, channels, rowbytes);
+}
+
+//! apeng_load_frames
+//! loads all frames array of buffers
+//! all buffers and the returned array must be deleted using free()
+APENG_DLLIMPORT unsigned int APENG_API apeng_load_frames(const char*   filename,
+														 uint8_t***	frames_array,
+														 unsigned int* frames,
+														 unsigned int* width,
+														 unsigned int* height,
+														 unsigned int* channels,
+														 unsigned int* rowbytes)
+{
+	std::shared_ptr<FILE> file(fopen(filename, "rb"), fclose);
+	assert(file);
+	return apeng_load_frames_file(file.get(), frames_array, frames, width, height, channels, rowbytes);
+}
+
+
+//! apeng_load_frames_info
+//! loads all frames array of buffers, along with per-frame info
+//!  dirty_rect_mode is one of apeng_dirty_rect_mode
+//! all buffers and the returned arrays must be deleted using free()
+APENG_DLLIMPORT unsigned int APENG_API apeng_load_frames_info(const char*		 filename,
+															  uint8_t***		 frames_array,
+															  apeng_frame_info** frames_info,
+															  unsigned int*		 frames,
+															  unsigned int*		 width,
+															  unsigned int*		 height,
+															  unsigned int*		 channels,
+															  unsigned int*		 rowbytes,
+															  unsigned int		 dirty_rect_mode)
+{
+	std::shared_ptr<FILE> file(fopen(filename, "rb"), fclose);
+	assert(file);
+	return apeng_load_frames_file_info(
+	  file.get(), frames_array, frames_info, frames, width, height, channels, rowbytes, dirty_rect_mode);
+}
+
+
+//! apeng_load_frames_opts
+//! loads the frames selected by options into an array of buffers, along with per-frame info
+//!  frames_info may be null, dirty rectangles are relative to the previous loaded frame
+//! all buffers and the returned arrays must be deleted using free()
+APENG_DLLIMPORT unsigned int APENG_API apeng_load_frames_opts(const char*				  filename,
+															  const apeng_decode_options* options,
+															  uint8_t***				  frames_array,
+															  apeng_frame_info**		  frames_info,
+															  unsigned int*				  frames,
+															  unsigned int*				  width,
+															  unsigned int*				  height,
+															  unsigned int*				  channels,
+															  unsigned int*				  rowbytes,
+															  unsigned int				  dirty_rect_mode)
+{
+	std::shared_ptr<FILE> file(fopen(filename, "rb"), fclose);
+	assert(file);
+	return apeng_load_frames_file_opts(
+	  file.get(), options, frames_array, frames_info, frames, width, height, channels, rowbytes, dirty_rect_mode);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//! mapped output
+//! rationale: frames that do not fit into RAM are decoded into a file-backed mapping,
+//! the same file can later be mapped again without parsing or decoding
+
+namespace
+{
+	//! raw-frame file header, frames follow at raw_data_offset
+	struct raw_frames_header
+	{
+		char	 magic[8];
+		uint32_t byte_order;
+		uint32_t version;
+		uint32_t width;
+		uint32_t height;
+		uint32_t channels;
+		uint32_t frames;
+		uint64_t rowbytes;
+		uint64_t frames_size;
+	};
+
+	const char	   raw_magic[8]		 = {'A', 'P', 'E', 'N', 'G', 'R', 'A', 'W'};
+	constexpr uint32_t raw_byte_order = 0x01020304u;
+	constexpr uint32_t raw_version	  = 1;
+	constexpr size_t   raw_data_offset = 4096;
+
+#ifndef _WIN32
+	//! decodes frames in place into a sparse, file-backed shared mapping
+	class mapped_receiver : public frame_receiver
+	{
+	public:
+		explicit mapped_receiver(const char* filename)
+		  : filename(filename)
+		  , fd(-1)
+		  , mapping(nullptr)
+		  , mapping_size(0)
+		  , framesize(0)
+		  , page_size(size_t(sysconf(_SC_PAGESIZE)))
+		  , released(0)
+		  , frames_written(0)
+		  , finished(false)
+		  , header()
+		{
+		}
+
+		~mapped_receiver()
+		{
+			if (mapping)
+			{
+				munmap(mapping, mapping_size);
+			}
+			if (fd >= 0)
+			{
+				close(fd);
+				//! a partially decoded file must not be mistaken for a valid one
+				if (!finished)
+				{
+					unlink(filename);
+				}
+			}
+		}
+
+		unsigned int begin(const frames_header& frames_header) override
+		{
+			framesize = frames_header.height * frames_header.rowbytes;
+
+			size_t blobsize;
+			if (!checked_mul(framesize, frames_header.frames, blobsize) || blobsize > SIZE_MAX - raw_data_offset)
+			{
+				return (unsigned int)APENG_ERROR::size_overflow;
+			}
+			mapping_size = raw_data_offset + blobsize;
+
+			fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+			if (fd < 0)
+			{
+				return (unsigned int)APENG_ERROR::file_invalid;
+			}
+
+			//! sized up front but sparse, pages are only allocated as frames are written
+			if (ftruncate(fd, off_t(mapping_size)) != 0)
+			{
+				return (unsigned int)APENG_ERROR::file_invalid;
+			}
+
+			void* ptr = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			if (ptr == MAP_FAILED)
+			{
+				return (unsigned int)APENG_ERROR::out_of_memory;
+			}
+			mapping = (uint8_t*)ptr;
+
+			memcpy(header.magic, raw_magic, sizeof(raw_magic));
+			header.byte_order  = raw_byte_order;
+			header.version	   = raw_version;
+			header.width	   = frames_header.width;
+			header.height	   = frames_header.height;
+			header.channels	   = frames_header.channels;
+			header.frames	   = frames_header.frames;
+			header.rowbytes	   = frames_header.rowbytes;
+			header.frames_size = blobsize;
+
+			return (unsigned int)APENG_ERROR::no_error;
+		}
+
+		unsigned int frame(unsigned int frameIdx, const uint8_t* canvas, const apeng_frame_info&) override
+		{
+			size_t offset = raw_data_offset + frameIdx * framesize;
+			memcpy(mapping + offset, canvas, framesize);
+
+			//! frames arrive in order, so every page before the end of this frame is complete,
+			//!  including the partial page shared with the previous frame
+			release_pages(offset + framesize);
+
+			++frames_written;
+			return (unsigned int)APENG_ERROR::no_error;
+		}
+
+		//! writes the header once every frame is in place, marking the file as valid
+		unsigned int finish()
+		{
+			if (!mapping || frames_written != header.frames)
+			{
+				return (unsigned int)APENG_ERROR::data_invalid;
+			}
+
+			memcpy(mapping, &header, sizeof(header));
+			finished = true;
+
+			//! the last page of the last frame, mapped up to the page end
+			release_pages(mapping_size + page_size - 1);
+			return (unsigned int)APENG_ERROR::no_error;
+		}
+
+		//! hands the mapping over to the caller
+		uint8_t* release()
+		{
+			uint8_t* result = mapping;
+			mapping			= nullptr;
+			return result;
+		}
+
+		//! starts writeback of the complete pages before end and lets them go
+		void release_pages(size_t end)
+		{
+			end &= ~(page_size - 1);
+			if (end > released)
+			{
+				msync(mapping + released, end - released, MS_ASYNC);
+				madvise(mapping + released, end - released, MADV_DONTNEED);
+				released = end;
+			}
+		}
+
+		const char*		  filename;
+		int				  fd;
+		uint8_t*		  mapping;
+		size_t			  mapping_size;
+		size_t			  framesize;
+		size_t			  page_size;
+		size_t			  released;		//! mapping bytes whose pages have been released
+		unsigned int	  frames_written;
+		bool			  finished;
+		raw_frames_header header;
+	};
+#endif	// _WIN32
+}	// namespace
+
+
+//! apeng_load_frames_file_mapped
+//! decodes the frames selected by options (may be null) into the raw-frame file out_filename
+//! and returns them mapped into memory as one large buffer frames_blob
+//!  out_filename can later be mapped again using apeng_map_frames()
+//!  frames_blob must be released using apeng_unmap_frames()
+APENG_DLLIMPORT unsigned int APENG_API apeng_load_frames_file_mapped(FILE*						file,
+																	 const apeng_decode_options* options,
+																	 const char*				 out_filename,
+																	 uint8_t**					 frames_blob,
+																	 size_t*					 frames_blob_size,
+																	 unsigned int*				 width,
+																	 unsigned int*				 height,
+																	 unsigned int*				 channels,
+																	 size_t*					 rowbytes,
+																	 unsigned int*				 frames)
+{
+	assert(file);
+	assert(out_filename);
+	assert(frames_blob);
+	assert(frames_blob_size);
+	assert(width);
+	assert(height);
+	assert(channels);
+	assert(rowbytes);
+	assert(frames);
+
+	*frames_blob = nullptr;
+
+#ifndef _WIN32
+	mapped_receiver receiver(out_filename);
+	unsigned int	err = decode_frames(file, receiver, APENG_DIRTY_RECT_FCTL, options);
+	if (err == (unsigned int)APENG_ERROR::no_error)
+	{
+		err = receiver.finish();
+	}
+	if (err != (unsigned int)APENG_ERROR::no_error)
+	{
+		return err;
+	}
+
+	*frames_blob	  = receiver.release() + raw_data_offset;
+	*frames_blob_size = receiver.header.frames_size;
+	*width			  = receiver.header.width;
+	*height			  = receiver.header.height;
+	*channels		  = receiver.header.channels;
+	*rowbytes		  = receiver.header.rowbytes;
+	*frames			  = receiver.header.frames;
+
+	return err;
+#else
+	(void)options;
+	return (unsigned int)APENG_ERROR::unsupported;
+#endif	// _WIN32
+}
+
+
+//! apeng_load_frames_mapped
+//! decodes the frames selected by options (may be null) into the raw-frame file out_filename
+//! and returns them mapped into memory as one large buffer frames_blob
+//!  frames_blob must be released using apeng_unmap_frames()
+APENG_DLLIMPORT unsigned int APENG_API apeng_load_frames_mapped(const char*				   filename,
+																const apeng_decode_options* options,
+																const char*				   out_filename,
+																uint8_t**				   frames_blob,
+																size_t*					   frames_blob_size,
+																unsigned int*			   width,
+																unsigned int*			   height,
+																unsigned int*			   channels,
+																size_t*					   rowbytes,
+																unsigned int*			   frames)
+{
+	std::shared_ptr<FILE> file(fopen(filename, "rb"), fclose);
+	assert(file);
+	return apeng_load_frames_file_mapped(
+	  file.get(), options, out_filename, frames_blob, frames_blob_size, width, height, channels, rowbytes, frames);
+}
+
+
+//! apeng_map_frames
+//! maps a raw-frame file written by apeng_load_frames_*_mapped() as one large buffer frames_blob
+//!  the mapping is private: writes to frames_blob do not reach the file
+//!  frames_blob must be released using apeng_unmap_frames()
+APENG_DLLIMPORT unsigned int APENG_API apeng_map_frames(const char*	  raw_filename,
+														uint8_t**	  frames_blob,
+														size_t*		  frames_blob_size,
+														unsigned int* width,
+														unsigned int* height,
+														unsigned int* channels,
+														size_t*		  rowbytes,
+														unsigned int* frames)
+{
+	assert(raw_filename);
+	assert(frames_blob);
+	assert(frames_blob_size);
+	assert(width);
+	assert(height);
+	assert(channels);
+	assert(rowbytes);
+	assert(frames);
+
+	*frames_blob = nullptr;
+
+#ifndef _WIN32
+	int fd = open(raw_filename, O_RDONLY);
+	if (fd < 0)
+	{
+		return (unsigned int)APENG_ERROR::file_invalid;
+	}
+
+	struct stat		  st;
+	raw_frames_header header;
+	size_t			  expected_size;
+	unsigned int	  err = (unsigned int)APENG_ERROR::no_error;
+	if (fstat(fd, &st) != 0 || uint64_t(st.st_size) < raw_data_offset
+		|| pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header))
+	{
+		err = (unsigned int)APENG_ERROR::file_invalid;
+	}
+	else if (memcmp(header.magic, raw_magic, sizeof(raw_magic)) != 0 || header.byte_order != raw_byte_order
+			 || header.version != raw_version || header.frames_size != uint64_t(st.st_size) - raw_data_offset
+			 || header.rowbytes > SIZE_MAX || header.frames_size > SIZE_MAX - raw_data_offset)
+	{
+		err = (unsigned int)APENG_ERROR::data_invalid;
+	}
+	else if (!checked_mul(size_t(header.rowbytes), header.height, expected_size)
+			 || !checked_mul(expected_size, header.frames, expected_size) || header.frames_size != expected_size)
+	{
+		err = (unsigned int)APENG_ERROR::data_invalid;
+	}
+
+	void* mapping = MAP_FAILED;
+	if (err == (unsigned int)APENG_ERROR::no_error)
+	{
+		mapping = mmap(nullptr, size_t(st.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		if (mapping == MAP_FAILED)
+		{
+			err = (unsigned int)APENG_ERROR::out_of_memory;
+		}
+	}
+	close(fd);
+
+	if (err != (unsigned int)APENG_ERROR::no_error)
+	{
+		return err;
+	}
+
+	*frames_blob	  = (uint8_t*)mapping + raw_data_offset;
+	*frames_blob_size = size_t(header.frames_size);
+	*width			  = header.width;
+	*height			  = header.height;
+	*channels		  = header.channels;
+	*rowbytes		  = size_t(header.rowbytes);
+	*frames			  = header.frames;
+
+	return err;
+#else
+	return (unsigned int)APENG_ERROR::unsupported;
+#endif	// _WIN32
+}
+
+
+//! apeng_unmap_frames
+//! releases a frames_blob returned by apeng_load_frames_*_mapped() or apeng_map_frames()
+APENG_DLLIMPORT void APENG_API apeng_unmap_frames(uint8_t* frames_blob, size_t frames_blob_size)
+{
+#ifndef _WIN32
+	if (frames_blob)
+	{
+		munmap(frames_blob - raw_data_offset, raw_data_offset + frames_blob_size);
+	}
+#else
+	(void)frames_blob;
+	(void)frames_blob_size;
+#endif	// _WIN32
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//! atlas
+
+namespace
+{
+	struct skyline_node
+	{
+		unsigned int x;
+		unsigned int y;
+		unsigned int width;
+	};
+
+	//! lowest y at which a rectangle of width w fits when left-aligned with nodes[nodeIdx]
+	bool skyline_fit(const std::vector<skyline_node>& nodes, size_t nodeIdx, unsigned int w, unsigned int atlas_width, unsigned int& y)
+	{
+		if (nodes[nodeIdx].x + w > atlas_width)
+		{
+			return false;
+		}
+
+		y					   = 0;
+		unsigned int remaining = w;
+		for (size_t i = nodeIdx; remaining > 0 && i < nodes.size(); ++i)
+		{
+			y = nodes[i].y > y ? nodes[i].y : y;
+			remaining -= nodes[i].width < remaining ? nodes[i].width : remaining;
+		}
+		return true;
+	}
+
+	//! bottom-left skyline packer over a fixed width and unbounded height
+	class skyline_packer
+	{
+	public:
+		explicit skyline_packer(unsigned int width)
+		  : width(width)
+		  , height(0)
+		{
+			nodes.push_back({0, 0, width});
+		}
+
+		bool insert(unsigned int w, unsigned int h, unsigned int& x, unsigned int& y)
+		{
+			size_t		 best_idx	= nodes.size();
+			unsigned int best_y		= 0;
+			unsigned int best_width = 0;
+			for (size_t i = 0; i < nodes.size(); ++i)
+			{
+				unsigned int fit_y;
+				if (skyline_fit(nodes, i, w, width, fit_y)
+					&& (best_idx == nodes.size() || fit_y < best_y || (fit_y == best_y && nodes[i].width < best_width)))
+				{
+					best_idx   = i;
+					best_y	   = fit_y;
+					best_width = nodes[i].width;
+				}
+			}
+			if (best_idx == nodes.size())
+			{
+				return false;
+			}
+
+			x = nodes[best_idx].x;
+			y = best_y;
+
+			skyline_node node = {x, y + h, w};
+			nodes.insert(nodes.begin() + best_idx, node);
+
+			//! shrink or drop the nodes now covered by the new one
+			for (size_t i = best_idx + 1; i < nodes.size();)
+			{
+				unsigned int right = node.x + node.width;
+				if (nodes[i].x >= right)
+				{
+					break;
+				}
+				unsigned int shrink = right - nodes[i].x;
+				if (nodes[i].width <= shrink)
+				{
+					nodes.erase(nodes.begin() + i);
+					continue;
+				}
+				nodes[i].x += shrink;
+				nodes[i].width -= shrink;
+				break;
+			}
+
+			for (size_t i = 0; i + 1 < nodes.size();)
+			{
+				if (nodes[i].y == nodes[i + 1].y)
+				{
+					nodes[i].width += nodes[i + 1].width;
+					nodes.erase(nodes.begin() + i + 1);
+				}
+				else
+				{
+					++i;
+				}
+			}
+
+			height = y + h > height ? y + h : height;
+			return true;
+		}
+
+		unsigned int used_height() const
+		{
+			return height;
+		}
+
+	private:
+		std::vector<skyline_node> nodes;
+		unsigned int			  width;
+		unsigned int			  height;
+	};
+
+	//! marks atlas frames without an image
+	constexpr unsigned int no_image = ~0u;
+
+	unsigned int next_pow2(unsigned int v)
+	{
+		unsigned int p = 1;
+		while (p < v && p < 0x80000000u)
+		{
+			p <<= 1;
+		}
+		return p;
+	}
+
+	//! largest power of two <= v, v must be non-zero
+	unsigned int prev_pow2(unsigned int v)
+	{
+		unsigned int p = 1;
+		while (p <= v / 2)
+		{
+			p <<= 1;
+		}
+		return p;
+	}
+
+	//! collects frames, trims and deduplicates them, then packs the unique images into one atlas
+	class atlas_builder
+	{
+	public:
+		atlas_builder(unsigned int flags, unsigned int padding)
+		  : flags(flags)
+		  , padding(padding)
+		  , first_empty(no_image)
+		{
+		}
+
+		//! adds one BGRA frame
+		//!  exceptions must not unwind through the setjmp() frame of decode_frames(), so they become out_of_memory
+		unsigned int add(const uint8_t* pixels, size_t rowbytes, unsigned int width, unsigned int height, const apeng_frame_info* info)
+		{
+			try
+			{
+				return add_frame(pixels, rowbytes, width, height, info);
+			}
+			catch (const std::exception&)
+			{
+				return (unsigned int)APENG_ERROR::out_of_memory;
+			}
+		}
+
+		//! packs all unique images and returns the atlas and its frame table
+		unsigned int build(unsigned int		  max_width,
+						   uint8_t**		  atlas,
+						   unsigned int*	  atlas_width,
+						   unsigned int*	  atlas_height,
+						   apeng_atlas_frame** atlas_frames)
+		{
+			try
+			{
+				return build_atlas(max_width, atlas, atlas_width, atlas_height, atlas_frames);
+			}
+			catch (const std::exception&)
+			{
+				return (unsigned int)APENG_ERROR::out_of_memory;
+			}
+		}
+
+	private:
+		unsigned int add_frame(
+		  const uint8_t* pixels, size_t rowbytes, unsigned int width, unsigned int height, const apeng_frame_info* info)
+		{
+			unsigned int x0 = 0;
+			unsigned int y0 = 0;
+			unsigned int x1 = width;
+			unsigned int y1 = height;
+			if (flags & APENG_ATLAS_TRIM)
+			{
+				trim(pixels, rowbytes, width, height, x0, y0, x1, y1);
+			}
+
+			apeng_atlas_frame entry;
+			memset(&entry, 0, sizeof(entry));
+			entry.width		= x1 - x0;
+			entry.height	= y1 - y0;
+			entry.offset_x	= entry.width > 0 ? x0 : 0;
+			entry.offset_y	= entry.height > 0 ? y0 : 0;
+			entry.delay_num = info ? info->delay_num : 1;
+			entry.delay_den = info ? info->delay_den : 10;
+			entry.source	= (unsigned int)frames.size();
+
+			//! fully transparent frames take no atlas space
+			if (entry.width == 0 || entry.height == 0)
+			{
+				entry.width = entry.height = 0;
+				if (flags & APENG_ATLAS_DEDUP)
+				{
+					first_empty	 = first_empty == no_image ? entry.source : first_empty;
+					entry.source = first_empty;
+				}
+				frames.push_back(entry);
+				images_of_frames.push_back(no_image);
+				return (unsigned int)APENG_ERROR::no_error;
+			}
+
+			size_t			  trimmed_rowbytes = size_t(entry.width) * 4;
+			const uint8_t*	  origin		   = pixels + y0 * rowbytes + size_t(x0) * 4;
+			uint64_t		  hash			   = hash_image(origin, rowbytes, entry.width, entry.height);
+			unsigned int	  imageIdx		   = no_image;
+			if (flags & APENG_ATLAS_DEDUP)
+			{
+				auto range = images_by_hash.equal_range(hash);
+				for (auto it = range.first; it != range.second && imageIdx == no_image; ++it)
+				{
+					const atlas_image& image = images[it->second];
+					if (image.width == entry.width && image.height == entry.height
+						&& same_image(image.pixels.data(), trimmed_rowbytes, origin, rowbytes, trimmed_rowbytes, entry.height))
+					{
+						imageIdx = it->second;
+					}
+				}
+			}
+
+			if (imageIdx == no_image)
+			{
+				atlas_image image;
+				image.width		  = entry.width;
+				image.height	  = entry.height;
+				image.first_frame = (unsigned int)frames.size();
+				image.x = image.y = 0;
+				image.pixels.resize(trimmed_rowbytes * entry.height);
+				for (unsigned int rowIdx = 0; rowIdx < entry.height; ++rowIdx)
+				{
+					memcpy(&image.pixels[rowIdx * trimmed_rowbytes], origin + rowIdx * rowbytes, trimmed_rowbytes);
+				}
+
+				imageIdx = (unsigned int)images.size();
+				images.push_back(std::move(image));
+				images_by_hash.insert(std::make_pair(hash, imageIdx));
+			}
+
+			entry.source = images[imageIdx].first_frame;
+			frames.push_back(entry);
+			images_of_frames.push_back(imageIdx);
+			return (unsigned int)APENG_ERROR::no_error;
+		}
+
+		//! the outputs are only allocated after the last allocation that can throw
+		unsigned int build_atlas(unsigned int		max_width,
+								 uint8_t**			atlas,
+								 unsigned int*		atlas_width,
+								 unsigned int*		atlas_height,
+								 apeng_atlas_frame** atlas_frames)
+		{
+			uint64_t	 area	   = 0;
+			unsigned int min_width = 1;
+			for (const atlas_image& image : images)
+			{
+				area += uint64_t(image.width + padding) * (image.height + padding);
+				min_width = image.width + padding > min_width ? image.width + padding : min_width;
+			}
+
+			//! aim for a square atlas, at least as wide as the widest image
+			unsigned int width = (unsigned int)ceil(sqrt(double(area)));
+			width			   = width > min_width ? width : min_width;
+			if (max_width > 0)
+			{
+				if (min_width > max_width)
+				{
+					return (unsigned int)APENG_ERROR::argument_invalid;
+				}
+				width = width < max_width ? width : max_width;
+			}
+			if (flags & APENG_ATLAS_POW2)
+			{
+				//! rounding up may pass max_width, the largest power of two below it must still fit the widest image
+				width = next_pow2(width);
+				if (max_width > 0 && width > max_width)
+				{
+					width = prev_pow2(max_width);
+					if (width < min_width)
+					{
+						return (unsigned int)APENG_ERROR::argument_invalid;
+					}
+				}
+			}
+
+			//! tallest first packs tighter
+			std::vector<unsigned int> order(images.size());
+			for (size_t i = 0; i < order.size(); ++i)
+			{
+				order[i] = (unsigned int)i;
+			}
+			std::sort(order.begin(), order.end(), [this](unsigned int a, unsigned int b) {
+				return images[a].height != images[b].height ? images[a].height > images[b].height
+															: images[a].width > images[b].width;
+			});
+
+			skyline_packer packer(width);
+			for (unsigned int imageIdx : order)
+			{
+				atlas_image& image = images[imageIdx];
+				if (!packer.insert(image.width + padding, image.height + padding, image.x, image.y))
+				{
+					return (unsigned int)APENG_ERROR::argument_invalid;
+				}
+			}
+
+			unsigned int height = packer.used_height() > 0 ? packer.used_height() : 1;
+			height				= (flags & APENG_ATLAS_POW2) ? next_pow2(height) : height;
+
+			size_t atlas_rowbytes;
+			size_t atlas_size;
+			if (!checked_mul(width, 4, atlas_rowbytes) || !checked_mul(atlas_rowbytes, height, atlas_size))
+			{
+				return (unsigned int)APENG_ERROR::size_overflow;
+			}
+
+			*atlas		  = (uint8_t*)calloc(atlas_size, 1);
+			*atlas_frames = (apeng_atlas_frame*)malloc((frames.empty() ? 1 : frames.size()) * sizeof(apeng_atlas_frame));
+			if (!*atlas || !*atlas_frames)
+			{
+				free(*atlas);
+				free(*atlas_frames);
+				*atlas		  = nullptr;
+				*atlas_frames = nullptr;
+				return (unsigned int)APENG_ERROR::out_of_memory;
+			}
+			*atlas_width  = width;
+			*atlas_height = height;
+
+			for (const atlas_image& image : images)
+			{
+				size_t image_rowbytes = size_t(image.width) * 4;
+				for (unsigned int rowIdx = 0; rowIdx < image.height; ++rowIdx)
+				{
+					memcpy(*atlas + (image.y + rowIdx) * atlas_rowbytes + size_t(image.x) * 4,
+						   &image.pixels[rowIdx * image_rowbytes],
+						   image_rowbytes);
+				}
+			}
+
+			for (size_t frameIdx = 0; frameIdx < frames.size(); ++frameIdx)
+			{
+				apeng_atlas_frame& entry = frames[frameIdx];
+				if (images_of_frames[frameIdx] != no_image)
+				{
+					const atlas_image& image = images[images_of_frames[frameIdx]];
+					entry.atlas_x			 = image.x;
+					entry.atlas_y			 = image.y;
+				}
+				entry.u0 = float(entry.atlas_x) / float(width);
+				entry.v0 = float(entry.atlas_y) / float(height);
+				entry.u1 = float(entry.atlas_x + entry.width) / float(width);
+				entry.v1 = float(entry.atlas_y + entry.height) / float(height);
+
+				(*atlas_frames)[frameIdx] = entry;
+			}
+
+			return (unsigned int)APENG_ERROR::no_error;
+		}
+
+		struct atlas_image
+		{
+			unsigned int		 width;
+			unsigned int		 height;
+			unsigned int		 first_frame;
+			unsigned int		 x;
+			unsigned int		 y;
+			std::vector<uint8_t> pixels;
+		};
+
+		//! bounds of the pixels with non-zero alpha, empty if there are none
+		static void trim(const uint8_t* pixels,
+						 size_t			rowbytes,
+						 unsigned int	width,
+						 unsigned int	height,
+						 unsigned int&	x0,
+						 unsigned int&	y0,
+						 unsigned int&	x1,
+						 unsigned int&	y1)
+		{
+			x0 = width;
+			y0 = height;
+			x1 = 0;
+			y1 = 0;
+			for (unsigned int y = 0; y < height; ++y)
+			{
+				const uint8_t* row = pixels + y * rowbytes;
+				for (unsigned int x = 0; x < width; ++x)
+				{
+					if (row[x * 4 + 3] != 0)
+					{
+						x0 = x < x0 ? x : x0;
+						x1 = x + 1 > x1 ? x + 1 : x1;
+						y0 = y < y0 ? y : y0;
+						y1 = y + 1;
+					}
+				}
+			}
+			if (x1 <= x0 || y1 <= y0)
+			{
+				x0 = y0 = x1 = y1 = 0;
+			}
+		}
+
+		//! FNV-1a over the trimmed pixels
+		static uint64_t hash_image(const uint8_t* pixels, size_t rowbytes, unsigned int width, unsigned int height)
+		{
+			uint64_t hash = 0xcbf29ce484222325ull;
+			for (unsigned int y = 0; y < height; ++y)
+			{
+				const uint8_t* row = pixels + y * rowbytes;
+				for (size_t i = 0; i < size_t(width) * 4; ++i)
+				{
+					hash = (hash ^ row[i]) * 0x100000001b3ull;
+				}
+			}
+			return hash;
+		}
+
+		static bool same_image(const uint8_t* a, size_t a_rowbytes, const uint8_t* b, size_t b_rowbytes, size_t size, unsigned int height)
+		{
+			for (unsigned int y = 0; y < height; ++y)
+			{
+				if (memcmp(a + y * a_rowbytes, b + y * b_rowbytes, size) != 0)
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		unsigned int									flags;
+		unsigned int									padding;
+		unsigned int									first_empty;
+		std::vector<atlas_image>						images;
+		std::unordered_multimap<uint64_t, unsigned int> images_by_hash;
+		std::vector<apeng_atlas_frame>					frames;
+		std::vector<unsigned int>						images_of_frames;
+	};
+
+	//! feeds decoded frames straight into an atlas_builder, without keeping full frames around
+	class atlas_receiver : public frame_receiver
+	{
+	public:
+		explicit atlas_receiver(atlas_builder& builder)
+		  : header()
+		  , builder(builder)
+		{
+		}
+
+		unsigned int begin(const frames_header& header) override
+		{
+			this->header = header;
+			return (unsigned int)APENG_ERROR::no_error;
+		}
+
+		unsigned int frame(unsigned int, const uint8_t* canvas, const apeng_frame_info& info) override
+		{
+			return builder.add(canvas, header.rowbytes, header.width, header.height, &info);
+		}
+
+		frames_header header;
+
+	private:
+		atlas_builder& builder;
+	};
+}	// namespace
+
+
+//! apeng_export_atlas
+//! packs frames_array into one atlas with a frame table
+//!  frames must be 4-channel BGRA as returned by the loaders, frames_info may be null
+//!  atlas and atlas_frames must be deleted using free()
+APENG_DLLIMPORT unsigned int APENG_API apeng_export_atlas(const uint8_t**		   frames_array,
+														  const apeng_frame_info*  frames_info,
+														  unsigned int			   frames,
+														  unsigned int			   width,
+														  unsigned int			   height,
+														  unsigned int			   rowbytes,
+														  unsigned int			   max_width,
+														  unsigned int			   padding,
+														  unsigned int			   flags,
+														  uint8_t**				   atlas,
+														  unsigned int*			   atlas_width,
+														  unsigned int*			   atlas_height,
+														  apeng_atlas_frame**	   atlas_frames)
+{
+	assert(frames_array);
+	assert(atlas);
+	assert(atlas_width);
+	assert(atlas_height);
+	assert(atlas_frames);
+
+	*atlas		  = nullptr;
+	*atlas_frames = nullptr;
+
+	atlas_builder builder(flags, padding);
+	for (unsigned int frameIdx = 0; frameIdx < frames; ++frameIdx)
+	{
+		unsigned int err = builder.add(frames_array[frameIdx], rowbytes, width, height, frames_info ? &frames_info[frameIdx] : nullptr);
+		if (err != (unsigned int)APENG_ERROR::no_error)
+		{
+			return err;
+		}
+	}
+
+	return builder.build(max_width, atlas, atlas_width, atlas_height, atlas_frames);
+}
+
+
+//! apeng_load_atlas_file
+//! loads the frames selected by options (may be null) straight into an atlas with a frame table
+//!  only trimmed, unique frames are kept in memory while decoding
+//!  atlas and atlas_frames must be deleted using free()
+APENG_DLLIMPORT unsigned int APENG_API apeng_load_atlas_file(FILE*						  file,
+															 const apeng_decode_options* options,
+															 unsigned int				  max_width,
+															 unsigned int				  padding,
+															 unsigned int				  flags,
+															 uint8_t**					  atlas,
+															 unsigned int*				  atlas_width,
+															 unsigned int*				  atlas_height,
+															 apeng_atlas_frame**		  atlas_frames,
+															 unsigned int*				  frames,
+															 unsigned int*				  width,
+															 unsigned int*				  height)
+{
+	assert(file);
+	assert(atlas);
+	assert(atlas_width);
+	assert(atlas_height);
+	assert(atlas_frames);
+	assert(frames);
+	assert(width);
+	assert(height);
+
+	*atlas		  = nullptr;
+	*atlas_frames = nullptr;
+
+	atlas_builder  builder(flags, padding);
+	atlas_receiver receiver(builder);
+	unsigned int   err = decode_frames(file, receiver, APENG_DIRTY_RECT_FCTL, options);
+	if (err != (unsigned int)APENG_ERROR::no_error)
+	{
+		return err;
+	}
+
+	*frames = receiver.header.frames;
+	*width	= receiver.header.width;
+	*height = receiver.header.height;
+
+	return builder.build(max_width, atlas, atlas_width, atlas_height, atlas_frames);
+}
+
+
+//! apeng_load_atlas
+//! loads the frames selected by options (may be null) straight into an atlas with a frame table
+//!  atlas and atlas_frames must be deleted using free()
+APENG_DLLIMPORT unsigned int APENG_API apeng_load_atlas(const char*				filename,
+														const apeng_decode_options* options,
+														unsigned int				max_width,
+														unsigned int				padding,
+														unsigned int				flags,
+														uint8_t**					atlas,
+														unsigned int*				atlas_width,
+														unsigned int*				atlas_height,
+														apeng_atlas_frame**			atlas_frames,
+														unsigned int*				frames,
+														unsigned int*				width,
+														unsigned int*				height)
+{
+	std::shared_ptr<FILE> file(fopen(filename, "rb"), fclose);
+	assert(file);
+	return apeng_load_atlas_file(
+	  file.get(), options, max_width, padding, flags, atlas, atlas_width, atlas_height, atlas_frames, frames, width, height);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//! editor
+//! rationale: retiming, looping, trimming and splicing only touch acTL/fcTL and the order of
+//! IDAT/fdAT chunks, so the compressed image data is copied through as-is
+
+namespace
+{
+	const uint8_t png_signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+	constexpr uint32_t chunk_type(const char (&name)[5])
+	{
+		return (uint32_t(uint8_t(name[0])) << 24) | (uint32_t(uint8_t(name[1])) << 16) | (uint32_t(uint8_t(name[2])) << 8)
+			   | uint32_t(uint8_t(name[3]));
+	}
+
+	constexpr uint32_t chunk_IHDR = chunk_type("IHDR");
+	constexpr uint32_t chunk_PLTE = chunk_type("PLTE");
+	constexpr uint32_t chunk_tRNS = chunk_type("tRNS");
+	constexpr uint32_t chunk_IDAT = chunk_type("IDAT");
+	constexpr uint32_t chunk_IEND = chunk_type("IEND");
+	constexpr uint32_t chunk_acTL = chunk_type("acTL");
+	constexpr uint32_t chunk_fcTL = chunk_type("fcTL");
+	constexpr uint32_t chunk_fdAT = chunk_type("fdAT");
+
+	//! PNG chunk lengths are limited to 2^31 - 1
+	constexpr uint32_t chunk_length_max = 0x7fffffffu;
+
+	//! chunk payloads are read in steps of this size, so a corrupt length cannot
+	//!  allocate more than the file actually holds
+	constexpr uint32_t chunk_read_step = 1u << 20;
+
+	//! fcTL payload without its sequence number
+	constexpr size_t fctl_size		  = 22;
+	constexpr size_t fctl_width		  = 0;
+	constexpr size_t fctl_height	  = 4;
+	constexpr size_t fctl_x_offset	= 8;
+	constexpr size_t fctl_y_offset	= 12;
+	constexpr size_t fctl_delay_num   = 16;
+	constexpr size_t fctl_delay_den   = 18;
+	constexpr size_t fctl_dispose_op  = 20;
+	constexpr size_t fctl_blend_op	= 21;
+
+	uint32_t read_u32(const uint8_t* p)
+	{
+		return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+	}
+
+	void write_u32(uint8_t* p, uint32_t v)
+	{
+		p[0] = uint8_t(v >> 24);
+		p[1] = uint8_t(v >> 16);
+		p[2] = uint8_t(v >> 8);
+		p[3] = uint8_t(v);
+	}
+
+	void write_u16(uint8_t* p, uint16_t v)
+	{
+		p[0] = uint8_t(v >> 8);
+		p[1] = uint8_t(v);
+	}
+
+	struct png_chunk
+	{
+		uint32_t			 type;
+		std::vector<uint8_t> data;
+	};
+
+	struct apng_frame
+	{
+		uint8_t							  fctl[fctl_size];
+		std::vector<std::vector<uint8_t>> data;	//! IDAT/fdAT payloads, without sequence numbers
+	};
+
+	//! chunk-level view of an APNG
+	//!  a plain PNG is promoted to a single-frame APNG
+	struct apng_stream
+	{
+		std::vector<uint8_t>			  ihdr;
+		std::vector<png_chunk>			  head;			//! ancillary chunks before the image data
+		std::vector<std::vector<uint8_t>> hidden_idat;  //! default image that is not part of the animation
+		std::vector<apng_frame>			  frames;
+		std::vector<png_chunk>			  tail;	//! ancillary chunks after the image data
+		uint32_t						  plays;
+	};
+
+	unsigned int read_chunk(FILE* file, png_chunk& chunk)
+	{
+		uint8_t header[8];
+		if (fread(header, 1, 8, file) != 8)
+		{
+			return (unsigned int)APENG_ERROR::data_invalid;
+		}
+
+		uint32_t length = read_u32(header);
+		if (length > chunk_length_max)
+		{
+			return (unsigned int)APENG_ERROR::data_invalid;
+		}
+
+		chunk.type = read_u32(header + 4);
+		chunk.data.clear();
+		while (chunk.data.size() < length)
+		{
+			size_t offset = chunk.data.size();
+			size_t step   = std::min<size_t>(length - offset, chunk_read_step);
+			chunk.data.resize(offset + step);
+			if (fread(chunk.data.data() + offset, 1, step, file) != step)
+			{
+				return (unsigned int)APENG_ERROR::data_invalid;
+			}
+		}
+
+		uint8_t crc_bytes[4];
+		if (fread(crc_bytes, 1, 4, file) != 4)
+		{
+			return (unsigned int)APENG_ERROR::data_invalid;
+		}
+
+		//! crc32() with a null buffer resets the crc, so empty payloads are skipped
+		uLong crc = crc32(0L, header + 4, 4);
+		if (length > 0)
+		{
+			crc = crc32(crc, chunk.data.data(), length);
+		}
+		if (read_u32(crc_bytes) != uint32_t(crc))
+		{
+			return (unsigned int)APENG_ERROR::data_invalid;
+		}
+
+		return (unsigned int)APENG_ERROR::no_error;
+	}
+
+	//! writes one chunk, prefixing the payload with sequence_number if non-null
+	unsigned int write_chunk(FILE* file, uint32_t type, const uint8_t* data, size_t size, const uint32_t* sequence_number)
+	{
+		size_t length = size + (sequence_number ? 4 : 0);
+		if (length > chunk_length_max)
+		{
+			return (unsigned int)APENG_ERROR::unsupported;
+		}
+
+		uint8_t header[12];
+		write_u32(header, uint32_t(length));
+		write_u32(header + 4, type);
+		if (sequence_number)
+		{
+			write_u32(header + 8, *sequence_number);
+		}
+		size_t header_size = sequence_number ? 12 : 8;
+
+		uLong crc = crc32(0L, header + 4, uInt(header_size - 4));
+		if (size > 0)
+		{
+			crc = crc32(crc, data, uInt(size));
+		}
+
+		uint8_t crc_bytes[4];
+		write_u32(crc_bytes, uint32_t(crc));
+
+		if (fwrite(header, 1, header_size, file) != header_size || (size > 0 && fwrite(data, 1, size, file) != size)
+			|| fwrite(crc_bytes, 1, 4, file) != 4)
+		{
+			return (unsigned int)APENG_ERROR::file_invalid;
+		}
+
+		return (unsigned int)APENG_ERROR::no_error;
+	}
+
+	unsigned int load_stream(FILE* file, apng_stream& stream)
+	{
+		assert(file);
+
+		uint8_t sig[8];
+		if (!(fread(sig, 1, 8, file) == 8 && memcmp(sig, png_signature, 8) == 0))
+		{
+			return (unsigned int)APENG_ERROR::data_invalid;
+		}
+
+		stream.plays		   = 0;
+		bool	   has_actl	= false;
+		bool	   has_data	= false;
+		bool	   has_iend	= false;
+		apng_frame* cur_frame = nullptr;
+
+		png_chunk chunk;
+		while (!has_iend)
+		{
+			unsigned int err = read_chunk(file, chunk);
+			if (err != (unsigned int)APENG_ERROR::no_error)
+			{
+				return err;
+			}
+
+			switch (chunk.type)
+			{
+				case chunk_IHDR:
+					stream.ihdr.swap(chunk.data);
+					break;
+
+				case chunk_acTL:
+					if (chunk.data.size() != 8)
+					{
+						return (unsigned int)APENG_ERROR::data_invalid;
+					}
+					has_actl	 = true;
+					stream.plays = read_u32(chunk.data.data() + 4);
+					break;
+
+				case chunk_fcTL:
+					if (chunk.data.size() != 4 + fctl_size)
+					{
+						return (unsigned int)APENG_ERROR::data_invalid;
+					}
+					stream.frames.emplace_back();
+					cur_frame = &stream.frames.back();
+					memcpy(cur_frame->fctl, chunk.data.data() + 4, fctl_size);
+					has_data = true;
+					break;
+
+				case chunk_IDAT:
+					if (cur_frame)
+					{
+						cur_frame->data.emplace_back();
+						cur_frame->data.back().swap(chunk.data);
+					}
+					else
+					{
+						stream.hidden_idat.emplace_back();
+						stream.hidden_idat.back().swap(chunk.data);
+					}
+					has_data = true;
+					break;
+
+				case chunk_fdAT:
+					if (!cur_frame || chunk.data.size() < 4)
+					{
+						return (unsigned int)APENG_ERROR::data_invalid;
+					}
+					cur_frame->data.emplace_back(chunk.data.begin() + 4, chunk.data.end());
+					break;
+
+				case chunk_IEND:
+					has_iend = true;
+					break;
+
+				//! must precede the image data, whether or not they precede the first fcTL
+				case chunk_PLTE:
+				case chunk_tRNS:
+					stream.head.push_back(chunk);
+					break;
+
+				default:
+					(has_data ? stream.tail : stream.head).push_back(chunk);
+					break;
+			}
+		}
+
+		if (stream.ihdr.size() != 13
+			|| (has_actl ? stream.frames.empty() : (stream.hidden_idat.empty() || !stream.frames.empty())))
+		{
+			return (unsigned int)APENG_ERROR::data_invalid;
+		}
+
+		if (!has_actl)
+		{
+			//! plain PNG: promote the default image to a full-canvas frame
+			apng_frame frame;
+			memset(frame.fctl, 0, fctl_size);
+			memcpy(frame.fctl + fctl_width, stream.ihdr.data(), 8);
+			write_u16(frame.fctl + fctl_delay_num, 1);
+			write_u16(frame.fctl + fctl_delay_den, 10);
+			frame.data.swap(stream.hidden_idat);
+			stream.frames.clear();
+			stream.frames.push_back(std::move(frame));
+		}
+
+		for (const apng_frame& frame : stream.frames)
+		{
+			if (frame.data.empty())
+			{
+				return (unsigned int)APENG_ERROR::data_invalid;
+			}
+		}
+
+		return (unsigned int)APENG_ERROR::no_error;
+	}
+
+	bool covers_canvas(const apng_stream& stream, const apng_frame& frame)
+	{
+		return memcmp(frame.fctl + fctl_width, stream.ihdr.data(), 8) == 0 && read_u32(frame.fctl + fctl_x_offset) == 0
+			   && read_u32(frame.fctl + fctl_y_offset) == 0;
+	}
+
+	//! checks that stream can be saved, before any output is written
+	unsigned int check_stream(const apng_stream& stream)
+	{
+		if (stream.frames.empty())
+		{
+			return (unsigned int)APENG_ERROR::argument_invalid;
+		}
+
+		//! without a hidden default image, the first frame is stored as IDAT and must cover the whole canvas
+		if (stream.hidden_idat.empty() && !covers_canvas(stream, stream.frames.front()))
+		{
+			return (unsigned int)APENG_ERROR::unsupported;
+		}
+
+		return (unsigned int)APENG_ERROR::no_error;
+	}
+
+	unsigned int save_stream(FILE* file, const apng_stream& stream)
+	{
+		assert(file);
+
+		unsigned int err = check_stream(stream);
+		if (err != (unsigned int)APENG_ERROR::no_error)
+		{
+			return err;
+		}
+
+		//! without a hidden default image, the first frame is stored as IDAT
+		bool first_is_default = stream.hidden_idat.empty();
+
+		if (fwrite(png_signature, 1, 8, file) != 8)
+		{
+			return (unsigned int)APENG_ERROR::file_invalid;
+		}
+
+		uint8_t actl[8];
+		write_u32(actl, uint32_t(stream.frames.size()));
+		write_u32(actl + 4, stream.plays);
+
+		err = write_chunk(file, chunk_IHDR, stream.ihdr.data(), stream.ihdr.size(), nullptr);
+		if (err == (unsigned int)APENG_ERROR::no_error)
+		{
+			err = write_chunk(file, chunk_acTL, actl, 8, nullptr);
+		}
+		for (size_t i = 0; i < stream.head.size() && err == (unsigned int)APENG_ERROR::no_error; ++i)
+		{
+			err = write_chunk(file, stream.head[i].type, stream.head[i].data.data(), stream.head[i].data.size(), nullptr);
+		}
+		for (size_t i = 0; i < stream.hidden_idat.size() && err == (unsigned int)APENG_ERROR::no_error; ++i)
+		{
+			err = write_chunk(file, chunk_IDAT, stream.hidden_idat[i].data(), stream.hidden_idat[i].size(), nullptr);
+		}
+
+		uint32_t sequence_number = 0;
+		for (size_t frameIdx = 0; frameIdx < stream.frames.size() && err == (unsigned int)APENG_ERROR::no_error; ++frameIdx)
+		{
+			const apng_frame& frame = stream.frames[frameIdx];
+			err						= write_chunk(file, chunk_fcTL, frame.fctl, fctl_size, &sequence_number);
+			++sequence_number;
+
+			bool as_idat = first_is_default && frameIdx == 0;
+			for (size_t i = 0; i < frame.data.size() && err == (unsigned int)APENG_ERROR::no_error; ++i)
+			{
+				if (as_idat)
+				{
+					err = write_chunk(file, chunk_IDAT, frame.data[i].data(), frame.data[i].size(), nullptr);
+				}
+				else
+				{
+					err = write_chunk(file, chunk_fdAT, frame.data[i].data(), frame.data[i].size(), &sequence_number);
+					++sequence_number;
+				}
+			}
+		}
+
+		for (size_t i = 0; i < stream.tail.size() && err == (unsigned int)APENG_ERROR::no_error; ++i)
+		{
+			err = write_chunk(file, stream.tail[i].type, stream.tail[i].data.data(), stream.tail[i].data.size(), nullptr);
+		}
+		if (err == (unsigned int)APENG_ERROR::no_error)
+		{
+			err = write_chunk(file, chunk_IEND, nullptr, 0, nullptr);
+		}
+
+		return err;
+	}
+
+	const png_chunk* find_chunk(const std::vector<png_chunk>& chunks, uint32_t type)
+	{
+		for (const png_chunk& chunk : chunks)
+		{
+			if (chunk.type == type)
+			{
+				return &chunk;
+			}
+		}
+		return nullptr;
+	}
+
+	bool same_chunk(const png_chunk* a, const png_chunk* b)
+	{
+		return (a == nullptr && b == nullptr) || (a != nullptr && b != nullptr && a->data == b->data);
+	}
+
+	//! the input is read completely and closed before the output is opened,
+	//!  so in_filename and out_filename may name the same file
+	unsigned int load_stream(const char* filename, apng_stream& stream)
+	{
+		std::shared_ptr<FILE> file(fopen(filename, "rb"), fclose);
+		assert(file);
+		return load_stream(file.get(), stream);
+	}
+
+	//! writes to a temporary file next to filename and renames it over filename once complete,
+	//!  so a failed write leaves an existing file (possibly the input) untouched
+	unsigned int save_stream(const char* filename, const apng_stream& stream)
+	{
+		unsigned int err = check_stream(stream);
+		if (err != (unsigned int)APENG_ERROR::no_error)
+		{
+			return err;
+		}
+
+		std::string temp_filename = std::string(filename) + ".XXXXXX";
+		FILE*		file		  = nullptr;
+#ifndef _WIN32
+		int fd = mkstemp(&temp_filename[0]);
+		if (fd >= 0)
+		{
+			//! keep the permissions of the file being replaced
+			struct stat st;
+			fchmod(fd, stat(filename, &st) == 0 ? (st.st_mode & 07777) : 0644);
+			file = fdopen(fd, "wb");
+			if (!file)
+			{
+				close(fd);
+				remove(temp_filename.c_str());
+			}
+		}
+#else
+		if (_mktemp_s(&temp_filename[0], temp_filename.size() + 1) == 0)
+		{
+			file = fopen(temp_filename.c_str(), "wb");
+		}
+#endif	// _WIN32
+		if (!file)
+		{
+			return (unsigned int)APENG_ERROR::file_invalid;
+		}
+
+		//! buffered write errors such as a full disk only show up when closing
+		err = save_stream(file, stream);
+		if (fclose(file) != 0 && err == (unsigned int)APENG_ERROR::no_error)
+		{
+			err = (unsigned int)APENG_ERROR::file_invalid;
+		}
+
+#ifdef _WIN32
+		//! rename() does not replace an existing file on Windows
+		if (err == (unsigned int)APENG_ERROR::no_error)
+		{
+			remove(filename);
+		}
+#endif	// _WIN32
+		if (err == (unsigned int)APENG_ERROR::no_error && rename(temp_filename.c_str(), filename) != 0)
+		{
+			err = (unsigned int)APENG_ERROR::file_invalid;
+		}
+		if (err != (unsigned int)APENG_ERROR::no_error)
+		{
+			remove(temp_filename.c_str());
+		}
+		return err;
+	}
+
+	unsigned int set_plays(apng_stream& stream, unsigned int plays)
+	{
+		stream.plays = plays;
+		return (unsigned int)APENG_ERROR::no_error;
+	}
+
+	unsigned int set_delays(
+	  apng_stream& stream, unsigned int first, unsigned int count, unsigned short delay_num, unsigned short delay_den)
+	{
+		if (first > stream.frames.size() || count > stream.frames.size() - first)
+		{
+			return (unsigned int)APENG_ERROR::argument_invalid;
+		}
+
+		for (unsigned int frameIdx = first; frameIdx < first + count; ++frameIdx)
+		{
+			write_u16(stream.frames[frameIdx].fctl + fctl_delay_num, delay_num);
+			write_u16(stream.frames[frameIdx].fctl + fctl_delay_den, delay_den);
+		}
+		return (unsigned int)APENG_ERROR::no_error;
+	}
+
+	//! the first frame has nothing to blend over or dispose to
+	//!  over a cleared canvas SOURCE draws the same pixels as OVER, only the dropped background is lost
+	void reset_first_frame(apng_frame& frame)
+	{
+		frame.fctl[fctl_blend_op] = PNG_BLEND_OP_SOURCE;
+		if (frame.fctl[fctl_dispose_op] == PNG_DISPOSE_OP_PREVIOUS)
+		{
+			frame.fctl[fctl_dispose_op] = PNG_DISPOSE_OP_BACKGROUND;
+		}
+	}
+
+	unsigned int trim_frames(apng_stream& stream, unsigned int first, unsigned int count)
+	{
+		if (count == 0 || first > stream.frames.size() || count > stream.frames.size() - first)
+		{
+			return (unsigned int)APENG_ERROR::argument_invalid;
+		}
+
+		//! the canvas is cleared before the first frame, so a partial frame would lose what the dropped frames drew
+		if (first > 0 && !covers_canvas(stream, stream.frames[first]))
+		{
+			return (unsigned int)APENG_ERROR::unsupported;
+		}
+
+		stream.frames.erase(stream.frames.begin() + first + count, stream.frames.end());
+		stream.frames.erase(stream.frames.begin(), stream.frames.begin() + first);
+
+		reset_first_frame(stream.frames.front());
+		return (unsigned int)APENG_ERROR::no_error;
+	}
+
+	//! appends the frames of stream_b to stream_a
+	unsigned int append_frames(apng_stream& stream_a, apng_stream& stream_b)
+	{
+		if (stream_a.ihdr != stream_b.ihdr
+			|| !same_chunk(find_chunk(stream_a.head, chunk_PLTE), find_chunk(stream_b.head, chunk_PLTE))
+			|| !same_chunk(find_chunk(stream_a.head, chunk_tRNS), find_chunk(stream_b.head, chunk_tRNS)))
+		{
+			return (unsigned int)APENG_ERROR::unsupported;
+		}
+
+		//! stream_b's first frame must replace the whole canvas for the result to look like a followed by b
+		if (!covers_canvas(stream_b, stream_b.frames.front()))
+		{
+			return (unsigned int)APENG_ERROR::unsupported;
+		}
+		reset_first_frame(stream_b.frames.front());
+
+		//! stream_b's hidden default image and ancillary chunks are dropped
+		stream_a.frames.reserve(stream_a.frames.size() + stream_b.frames.size());
+		for (apng_frame& frame : stream_b.frames)
+		{
+			stream_a.frames.push_back(std::move(frame));
+		}
+		return (unsigned int)APENG_ERROR::no_error;
+	}
+}	// namespace
+
+
+//! apeng_edit_file_plays
+//! copies in_file to out_file with the acTL loop count set to plays
+//!  plays == 0 loops forever
+APENG_DLLIMPORT unsigned int APENG_API apeng_edit_file_plays(FILE* in_file, FILE* out_file, unsigned int plays)
+{
+	apng_stream  stream;
+	unsigned int err = load_stream(in_file, stream);
+	if (err == (unsigned int)APENG_ERROR::no_error)
+	{
+		err = set_plays(stream, plays);
+	}
+	return err == (unsigned int)APENG_ERROR::no_error ? save_stream(out_file, stream) : err;
+}
+
+
+//! apeng_edit_file_delays
+//! copies in_file to out_file with the delay of frames [first, first + count)
+//! set to delay_num / delay_den seconds
+APENG_DLLIMPORT unsigned int APENG_API apeng_edit_file_delays(FILE*			 in_file,
+															  FILE*			 out_file,
+															  unsigned int	 first,
+															  unsigned int	 count,
+															  unsigned short delay_num,
+															  unsigned short delay_den)
+{
+	apng_stream  stream;
+	unsigned int err = load_stream(in_file, stream);
+	if (err == (unsigned int)APENG_ERROR::no_error)
+	{
+		err = set_delays(stream, first, count, delay_num, delay_den);
+	}
+	return err == (unsigned int)APENG_ERROR::no_error ? save_stream(out_file, stream) : err;
+}
+
+
+//! apeng_edit_file_trim
+//! copies frames [first, first + count) of in_file to out_file
+//!  if first > 0 the new first frame must cover the whole canvas; it is drawn onto a cleared canvas,
+//!  so translucent pixels it blended over the dropped frames show the background instead
+APENG_DLLIMPORT unsigned int APENG_API apeng_edit_file_trim(FILE*		 in_file,
+															FILE*		 out_file,
+															unsigned int first,
+															unsigned int count)
+{
+	apng_stream  stream;
+	unsigned int err = load_stream(in_file, stream);
+	if (err == (unsigned int)APENG_ERROR::no_error)
+	{
+		err = trim_frames(stream, first, count);
+	}
+	return err == (unsigned int)APENG_ERROR::no_error ? save_stream(out_file, stream) : err;
+}
+
+
+//! apeng_edit_file_concat
+//! writes the frames of in_file_a followed by the frames of in_file_b to out_file
+//!  both inputs must share the same IHDR (and PLTE/tRNS if present)
+//!  and the first frame of in_file_b must cover the whole canvas
+APENG_DLLIMPORT unsigned int APENG_API apeng_edit_file_concat(FILE* in_file_a, FILE* in_file_b, FILE* out_file)
+{
+	apng_stream  stream_a;
+	apng_stream  stream_b;
+	unsigned int err = load_stream(in_file_a, stream_a);
+	if (err == (unsigned int)APENG_ERROR::no_error)
+	{
+		err = load_stream(in_file_b, stream_b);
+	}
+	if (err == (unsigned int)APENG_ERROR::no_error)
+	{
+		err = append_frames(stream_a, stream_b);
+	}
+	return err == (unsigned int)APENG_ERROR::no_error ? save_stream(out_file, stream_a) : err;
+}
+
+
+//! apeng_edit_plays
+//! copies in_filename to out_filename with the acTL loop count set to plays
+//!  plays == 0 loops forever; out_filename may be in_filename
+APENG_DLLIMPORT unsigned int APENG_API apeng_edit_plays(const char* in_filename, const char* out_filename, unsigned int plays)
+{
+	apng_stream  stream;
+	unsigned int err = load_stream(in_filename, stream);
+	if (err == (unsigned int)APENG_ERROR::no_error)
+	{
+		err = set_plays(stream, plays);
+	}
+	return err == (unsigned int)APENG_ERROR::no_error ? save_stream(out_filename, stream) : err;
+}
+
+
+//! apeng_edit_delays
+//! copies in_filename to out_filename with the delay of frames [first, first + count)
+//! set to delay_num / delay_den seconds; out_filename may be in_filename
+APENG_DLLIMPORT unsigned int APENG_API apeng_edit_delays(const char*	in_filename,
+														 const char*	out_filename,
+														 unsigned int   first,
+														 unsigned int   count,
+														 unsigned short delay_num,
+														 unsigned short delay_den)
+{
+	apng_stream  stream;
+	unsigned int err = load_stream(in_filename, stream);
+	if (err == (unsigned int)APENG_ERROR::no_error)
+	{
+		err = set_delays(stream, first, count, delay_num, delay_den);
+	}
+	return err == (unsigned int)APENG_ERROR::no_error ? save_stream(out_filename, stream) : err;
+}
+
+
+//! apeng_edit_trim
+//! copies frames [first, first + count) of in_filename to out_filename; out_filename may be in_filename
+//!  if first > 0 the new first frame must cover the whole canvas; it is drawn onto a cleared canvas,
+//!  so translucent pixels it blended over the dropped frames show the background instead
+APENG_DLLIMPORT unsigned int APENG_API apeng_edit_trim(const char*  in_filename,
+													   const char*  out_filename,
+													   unsigned int first,
+													   unsigned int count)
 {
-	std::shared_ptr<FILE> file(fopen(filename, "rb"), fclose);
-	assert(file);
-	return apeng_load_frames_file(file.get(), frames_array, frames, width, height, channels, rowbytes);
+	apng_stream  stream;
+	unsigned int err = load_stream(in_filename, stream);
+	if (err == (unsigned int)APENG_ERROR::no_error)
+	{
+		err = trim_frames(stream, first, count);
+	}
+	return err == (unsigned int)APENG_ERROR::no_error ? save_stream(out_filename, stream) : err;
+}
+
+
+//! apeng_edit_concat
+//! writes the frames of in_filename_a followed by the frames of in_filename_b to out_filename
+//!  both inputs must share the same IHDR (and PLTE/tRNS if present)
+//!  and the first frame of in_filename_b must cover the whole canvas; out_filename may be either input
+APENG_DLLIMPORT unsigned int APENG_API apeng_edit_concat(const char* in_filename_a,
+														 const char* in_filename_b,
+														 const char* out_filename)
+{
+	apng_stream  stream_a;
+	apng_stream  stream_b;
+	unsigned int err = load_stream(in_filename_a, stream_a);
+	if (err == (unsigned int)APENG_ERROR::no_error)
+	{
+		err = load_stream(in_filename_b, stream_b);
+	}
+	if (err == (unsigned int)APENG_ERROR::no_error)
+	{
+		err = append_frames(stream_a, stream_b);
+	}
+	return err == (unsigned int)APENG_ERROR::no_error ? save_stream(out_filename, stream_a) : err;
 }
 
 
@@ -461,6 +3286,93 @@ APENG_DLLIMPORT unsigned int APENG_API apeng::load_frames(const char*   filename
 }
 
 
+APENG_DLLIMPORT unsigned int APENG_API apeng::load_frames64(FILE*		 file,
+															uint8_t**	 frames_blob,
+															size_t*		  frames_blob_size,
+															unsigned int* width,
+															unsigned int* height,
+															unsigned int* channels,
+															size_t*		  rowbytes,
+															unsigned int* frames)
+{
+	return ::apeng_load_frames_file_blob64(file, frames_blob, frames_blob_size, width, height, channels, rowbytes, frames);
+}
+
+
+APENG_DLLIMPORT unsigned int APENG_API apeng::load_frames64(const char*   filename,
+															uint8_t**	 frames_blob,
+															size_t*		  frames_blob_size,
+															unsigned int* width,
+															unsigned int* height,
+															unsigned int* channels,
+															size_t*		  rowbytes,
+															unsigned int* frames)
+{
+	return ::apeng_load_frames_blob64(filename, frames_blob, frames_blob_size, width, height, channels, rowbytes, frames);
+}
+
+
+APENG_DLLIMPORT unsigned int APENG_API apeng::load_frames(FILE*			  file,
+														  uint8_t***		  frames_array,
+														  apeng_frame_info** frames_info,
+														  unsigned int*	  frames,
+														  unsigned int*	  width,
+														  unsigned int*	  height,
+														  unsigned int*	  channels,
+														  unsigned int*	  rowbytes,
+														  unsigned int	   dirty_rect_mode)
+{
+	return ::apeng_load_frames_file_info(
+	  file, frames_array, frames_info, frames, width, height, channels, rowbytes, dirty_rect_mode);
+}
+
+
+APENG_DLLIMPORT unsigned int APENG_API apeng::load_frames(const char*		  filename,
+														  uint8_t***		  frames_array,
+														  apeng_frame_info** frames_info,
+														  unsigned int*	  frames,
+														  unsigned int*	  width,
+														  unsigned int*	  height,
+														  unsigned int*	  channels,
+														  unsigned int*	  rowbytes,
+														  unsigned int	   dirty_rect_mode)
+{
+	return ::apeng_load_frames_info(filename, frames_array, frames_info, frames, width, height, channels, rowbytes, dirty_rect_mode);
+}
+
+
+APENG_DLLIMPORT unsigned int APENG_API apeng::load_frames(FILE*						file,
+														  const apeng_decode_options& options,
+														  uint8_t***				  frames_array,
+														  apeng_frame_info**		  frames_info,
+														  unsigned int*				  frames,
+														  unsigned int*				  width,
+														  unsigned int*				  height,
+														  unsigned int*				  channels,
+														  unsigned int*				  rowbytes,
+														  unsigned int				  dirty_rect_mode)
+{
+	return ::apeng_load_frames_file_opts(
+	  file, &options, frames_array, frames_info, frames, width, height, channels, rowbytes, dirty_rect_mode);
+}
+
+
+APENG_DLLIMPORT unsigned int APENG_API apeng::load_frames(const char*				  filename,
+														  const apeng_decode_options& options,
+														  uint8_t***				  frames_array,
+														  apeng_frame_info**		  frames_info,
+														  unsigned int*				  frames,
+														  unsigned int*				  width,
+														  unsigned int*				  height,
+														  unsigned int*				  channels,
+														  unsigned int*				  rowbytes,
+														  unsigned int				  dirty_rect_mode)
+{
+	return ::apeng_load_frames_opts(
+	  filename, &options, frames_array, frames_info, frames, width, height, channels, rowbytes, dirty_rect_mode);
+}
+
+
 APENG_DLLIMPORT unsigned int APENG_API apeng::save_frames(FILE*			 file,
 														  const uint8_t* frames_blob,
 														  unsigned int   frames_blob_size,
@@ -522,6 +3434,593 @@ APENG_DLLIMPORT unsigned int APENG_API apeng::save_frames(const char*	 filename,
 	return ::apeng_save_frames(filename, frames_array, frames, width, height, colortype, rowbytes);
 }
 
+
+APENG_DLLIMPORT unsigned int APENG_API apeng::save_frames64(FILE*			 file,
+															const uint8_t* frames_blob,
+															size_t		   frames_blob_size,
+															unsigned int   width,
+															unsigned int   height,
+															unsigned int   colortype,
+															size_t		   rowbytes,
+															unsigned int   frames)
+{
+	return ::apeng_save_frames_file_blob64(file, frames_blob, frames_blob_size, width, height, colortype, rowbytes, frames);
+}
+
+
+APENG_DLLIMPORT unsigned int APENG_API apeng::save_frames64(const char*	filename,
+															const uint8_t* frames_blob,
+															size_t		   frames_blob_size,
+															unsigned int   width,
+															unsigned int   height,
+															unsigned int   colortype,
+															size_t		   rowbytes,
+															unsigned int   frames)
+{
+	return ::apeng_save_frames_blob64(filename, frames_blob, frames_blob_size, width, height, colortype, rowbytes, frames);
+}
+
+
+APENG_DLLIMPORT unsigned int APENG_API apeng::load_frames_mapped(FILE*						file,
+																 const apeng_decode_options* options,
+																 const char*				 out_filename,
+																 uint8_t**					 frames_blob,
+																 size_t*					 frames_blob_size,
+																 unsigned int*				 width,
+																 unsigned int*				 height,
+																 unsigned int*				 channels,
+																 size_t*					 rowbytes,
+																 unsigned int*				 frames)
+{
+	return ::apeng_load_frames_file_mapped(
+	  file, options, out_filename, frames_blob, frames_blob_size, width, height, channels, rowbytes, frames);
+}
+
+
+APENG_DLLIMPORT unsigned int APENG_API apeng::load_frames_mapped(const char*				   filename,
+																 const apeng_decode_options* options,
+																 const char*				   out_filename,
+																 uint8_t**					   frames_blob,
+																 size_t*					   frames_blob_size,
+																 unsigned int*				   width,
+																 unsigned int*				   height,
+																 unsigned int*				   channels,
+																 size_t*					   rowbytes,
+																 unsigned int*				   frames)
+{
+	return ::apeng_load_frames_mapped(
+	  filename, options, out_filename, frames_blob, frames_blob_size, width, height, channels, rowbytes, frames);
+}
+
+
+APENG_DLLIMPORT unsigned int APENG_API apeng::map_frames(const char*	raw_filename,
+														 uint8_t**		frames_blob,
+														 size_t*		frames_blob_size,
+														 unsigned int*	width,
+														 unsigned int*	height,
+														 unsigned int*	channels,
+														 size_t*		rowbytes,
+														 unsigned int*	frames)
+{
+	return ::apeng_map_frames(raw_filename, frames_blob, frames_blob_size, width, height, channels, rowbytes, frames);
+}
+
+
+APENG_DLLIMPORT void APENG_API apeng::unmap_frames(uint8_t* frames_blob, size_t frames_blob_size)
+{
+	::apeng_unmap_frames(frames_blob, frames_blob_size);
+}
+
+
+APENG_DLLIMPORT unsigned int APENG_API apeng::edit_plays(FILE* in_file, FILE* out_file, unsigned int plays)
+{
+	return ::apeng_edit_file_plays(in_file, out_file, plays);
+}
+
+
+APENG_DLLIMPORT unsigned int APENG_API apeng::edit_delays(FILE*			in_file,
+														  FILE*			out_file,
+														  unsigned int   first,
+														  unsigned int   count,
+														  unsigned short delay_num,
+														  unsigned short delay_den)
+{
+	return ::apeng_edit_file_delays(in_file, out_file, first, count, delay_num, delay_den);
+}
+
+
+APENG_DLLIMPORT unsigned int APENG_API apeng::edit_trim(FILE* in_file, FILE* out_file, unsigned int first, unsigned int count)
+{
+	return ::apeng_edit_file_trim(in_file, out_file, first, count);
+}
+
+
+APENG_DLLIMPORT unsigned int APENG_API apeng::edit_concat(FILE* in_file_a, FILE* in_file_b, FILE* out_file)
+{
+	return ::apeng_edit_file_concat(in_file_a, in_file_b, out_file);
+}
+
+
+APENG_DLLIMPORT unsigned int APENG_API apeng::edit_plays(const char* in_filename, const char* out_filename, unsigned int plays)
+{
+	return ::apeng_edit_plays(in_filename, out_filename, plays);
+}
+
+
+APENG_DLLIMPORT unsigned int APENG_API apeng::edit_delays(const char*	in_filename,
+														  const char*	out_filename,
+														  unsigned int   first,
+														  unsigned int   count,
+														  unsigned short delay_num,
+														  unsigned short delay_den)
+{
+	return ::apeng_edit_delays(in_filename, out_filename, first, count, delay_num, delay_den);
+}
+
+
+APENG_DLLIMPORT unsigned int APENG_API apeng::edit_trim(const char*  in_filename,
+														const char*  out_filename,
+														unsigned int first,
+														unsigned int count)
+{
+	return ::apeng_edit_trim(in_filename, out_filename, first, count);
+}
+
+
+APENG_DLLIMPORT unsigned int APENG_API apeng::edit_concat(const char* in_filename_a,
+														  const char* in_filename_b,
+														  const char* out_filename)
+{
+	return ::apeng_edit_concat(in_filename_a, in_filename_b, out_filename);
+}
+
+
+APENG_DLLIMPORT unsigned int APENG_API apeng::export_atlas(const uint8_t**		   frames_array,
+														   const apeng_frame_info* frames_info,
+														   unsigned int			   frames,
+														   unsigned int			   width,
+														   unsigned int			   height,
+														   unsigned int			   rowbytes,
+														   unsigned int			   max_width,
+														   unsigned int			   padding,
+														   unsigned int			   flags,
+														   uint8_t**			   atlas,
+														   unsigned int*		   atlas_width,
+														   unsigned int*		   atlas_height,
+														   apeng_atlas_frame**	   atlas_frames)
+{
+	return ::apeng_export_atlas(frames_array,
+								frames_info,
+								frames,
+								width,
+								height,
+								rowbytes,
+								max_width,
+								padding,
+								flags,
+								atlas,
+								atlas_width,
+								atlas_height,
+								atlas_frames);
+}
+
+
+APENG_DLLIMPORT unsigned int APENG_API apeng::load_atlas(FILE*						 file,
+														 const apeng_decode_options* options,
+														 unsigned int				 max_width,
+														 unsigned int				 padding,
+														 unsigned int				 flags,
+														 uint8_t**					 atlas,
+														 unsigned int*				 atlas_width,
+														 unsigned int*				 atlas_height,
+														 apeng_atlas_frame**		 atlas_frames,
+														 unsigned int*				 frames,
+														 unsigned int*				 width,
+														 unsigned int*				 height)
+{
+	return ::apeng_load_atlas_file(
+	  file, options, max_width, padding, flags, atlas, atlas_width, atlas_height, atlas_frames, frames, width, height);
+}
+
+
+APENG_DLLIMPORT unsigned int APENG_API apeng::load_atlas(const char*				 filename,
+														 const apeng_decode_options* options,
+														 unsigned int				 max_width,
+														 unsigned int				 padding,
+														 unsigned int				 flags,
+														 uint8_t**					 atlas,
+														 unsigned int*				 atlas_width,
+														 unsigned int*				 atlas_height,
+														 apeng_atlas_frame**		 atlas_frames,
+														 unsigned int*				 frames,
+														 unsigned int*				 width,
+														 unsigned int*				 height)
+{
+	return ::apeng_load_atlas(
+	  filename, options, max_width, padding, flags, atlas, atlas_width, atlas_height, atlas_frames, frames, width, height);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+//! frame cache
+
+namespace
+{
+	struct frame_key
+	{
+		std::string  filename;
+		int64_t		 mtime;
+		uint64_t	 filesize;
+		unsigned int frameIdx;
+		unsigned int downscale;
+
+		bool operator==(const frame_key& other) const
+		{
+			return frameIdx == other.frameIdx && downscale == other.downscale && mtime == other.mtime
+				   && filesize == other.filesize && filename == other.filename;
+		}
+	};
+
+	struct frame_key_hash
+	{
+		size_t operator()(const frame_key& key) const
+		{
+			size_t h = std::hash<std::string>()(key.filename);
+			h ^= std::hash<int64_t>()(key.mtime) + 0x9e3779b9 + (h << 6) + (h >> 2);
+			h ^= std::hash<uint64_t>()(key.filesize) + 0x9e3779b9 + (h << 6) + (h >> 2);
+			h ^= std::hash<unsigned int>()(key.frameIdx) + 0x9e3779b9 + (h << 6) + (h >> 2);
+			h ^= std::hash<unsigned int>()(key.downscale) + 0x9e3779b9 + (h << 6) + (h >> 2);
+			return h;
+		}
+	};
+
+	//! frame_view owning its malloc()'d pixels
+	struct cached_frame : apeng::frame_view
+	{
+		cached_frame()
+		{
+			pixels = nullptr;
+		}
+
+		~cached_frame()
+		{
+			free((void*)pixels);
+		}
+
+		cached_frame(const cached_frame&) = delete;
+		cached_frame& operator=(const cached_frame&) = delete;
+	};
+
+	struct cache_entry
+	{
+		frame_key							key;
+		std::shared_ptr<const cached_frame> frame;
+		size_t								bytes;
+	};
+
+	//! decode in progress for one key, shared by the threads that missed it
+	struct pending_decode
+	{
+		std::condition_variable done_cond;	//! waited on with the shard mutex
+		bool					done  = false;
+		apeng::frame_ref		frame;
+		unsigned int			err = (unsigned int)APENG_ERROR::no_error;
+	};
+
+	struct cache_shard
+	{
+		typedef std::list<cache_entry> lru_list;
+
+		std::mutex																  mutex;
+		lru_list																  lru;	//! most recently used first
+		std::unordered_map<frame_key, lru_list::iterator, frame_key_hash> index;
+		std::unordered_map<frame_key, std::shared_ptr<pending_decode>, frame_key_hash> pending;
+		size_t																	  bytes = 0;
+	};
+
+	//! completes a pending_decode on every exit path, so waiters never block on a decode that threw
+	struct pending_completion
+	{
+		cache_shard&					 shard;
+		const frame_key&				 key;
+		std::shared_ptr<pending_decode>& pending;
+		apeng::frame_ref				 frame;
+		unsigned int					 err;
+
+		~pending_completion()
+		{
+			{
+				std::lock_guard<std::mutex> lock(shard.mutex);
+				pending->frame = frame;
+				pending->err   = err;
+				pending->done  = true;
+				shard.pending.erase(key);
+			}
+			pending->done_cond.notify_all();
+		}
+	};
+
+	//! returned by cache_receiver to stop decoding after the requested frame, never seen by callers
+	constexpr unsigned int decode_stopped = ~0u;
+
+	//! keeps frames 0..last as cached frames and stops decoding after last
+	//!  rationale: every frame up to last is composited anyway, so keeping them costs only the copies
+	class cache_receiver : public frame_receiver
+	{
+	public:
+		explicit cache_receiver(unsigned int last)
+		  : last(last)
+		  , header()
+		{
+		}
+
+		unsigned int begin(const frames_header& frames_header) override
+		{
+			header = frames_header;
+			if (last >= header.frames)
+			{
+				return (unsigned int)APENG_ERROR::argument_invalid;
+			}
+
+			//! exceptions must not unwind through the setjmp() frame of decode_frames()
+			try
+			{
+				frames.reserve(size_t(last) + 1);
+			}
+			catch (const std::exception&)
+			{
+				return (unsigned int)APENG_ERROR::out_of_memory;
+			}
+			return (unsigned int)APENG_ERROR::no_error;
+		}
+
+		unsigned int frame(unsigned int frameIdx, const uint8_t* canvas, const apeng_frame_info& info) override
+		{
+			size_t framesize = header.height * header.rowbytes;
+			try
+			{
+				std::shared_ptr<cached_frame> frame = std::make_shared<cached_frame>();
+				uint8_t*					  pixels = (uint8_t*)malloc(framesize);
+				if (!pixels)
+				{
+					return (unsigned int)APENG_ERROR::out_of_memory;
+				}
+				memcpy(pixels, canvas, framesize);
+
+				frame->pixels	= pixels;
+				frame->width	= header.width;
+				frame->height	= header.height;
+				frame->channels = header.channels;
+				frame->rowbytes = header.rowbytes;
+				frame->info		= info;
+				frames.push_back(frame);
+			}
+			catch (const std::exception&)
+			{
+				return (unsigned int)APENG_ERROR::out_of_memory;
+			}
+			return frameIdx == last ? decode_stopped : (unsigned int)APENG_ERROR::no_error;
+		}
+
+		std::vector<std::shared_ptr<const cached_frame>> frames;
+
+	private:
+		unsigned int  last;
+		frames_header header;
+	};
+
+	//! modification time in nanoseconds where the platform provides it,
+	//!  so a file rewritten within the same second is not served from the cache
+	int64_t mtime_ns(const struct stat& st)
+	{
+#if defined(_WIN32)
+		return int64_t(st.st_mtime) * 1000000000;
+#elif defined(__APPLE__)
+		return int64_t(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+		return int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif	// _WIN32
+	}
+}	// namespace
+
+
+struct apeng::frame_cache::impl
+{
+	impl(size_t budget, unsigned int shard_count)
+	  : shard_budget(budget / shard_count)
+	  , shards(shard_count)
+	{
+	}
+
+	cache_shard& shard(const frame_key& key)
+	{
+		return shards[frame_key_hash()(key) % shards.size()];
+	}
+
+	//! inserts entry, evicting least-recently-used entries of its shard to stay within budget
+	//!  an entry larger than the whole shard budget is not cached, rather than emptying the shard
+	void insert(cache_entry entry)
+	{
+		if (entry.bytes > shard_budget)
+		{
+			return;
+		}
+
+		cache_shard&				shard = this->shard(entry.key);
+		std::lock_guard<std::mutex> lock(shard.mutex);
+
+		if (shard.index.find(entry.key) != shard.index.end())
+		{
+			return;
+		}
+
+		shard.bytes += entry.bytes;
+		shard.lru.push_front(std::move(entry));
+		shard.index[shard.lru.front().key] = shard.lru.begin();
+
+		while (shard.bytes > shard_budget && !shard.lru.empty())
+		{
+			const cache_entry& victim = shard.lru.back();
+			shard.bytes -= victim.bytes;
+			shard.index.erase(victim.key);
+			shard.lru.pop_back();
+			++evictions;
+		}
+	}
+
+	size_t					 shard_budget;
+	std::vector<cache_shard> shards;
+
+	std::atomic<uint64_t> hits{0};
+	std::atomic<uint64_t> misses{0};
+	std::atomic<uint64_t> evictions{0};
+};
+
+
+apeng::frame_cache::frame_cache(size_t budget, unsigned int shards)
+  : pimpl(new impl(budget, shards > 0 ? shards : 1))
+{
+}
+
+
+apeng::frame_cache::~frame_cache()
+{
+	delete pimpl;
+}
+
+
+apeng::frame_ref apeng::frame_cache::get(const char* filename, unsigned int frameIdx, unsigned int* err, unsigned int downscale)
+{
+	assert(filename);
+
+	if (err)
+	{
+		*err = (unsigned int)APENG_ERROR::no_error;
+	}
+
+	struct stat st;
+	if (stat(filename, &st) != 0)
+	{
+		if (err)
+		{
+			*err = (unsigned int)APENG_ERROR::file_invalid;
+		}
+		return frame_ref();
+	}
+
+	downscale	 = downscale > 1 ? downscale : 1;
+	frame_key key = {filename, mtime_ns(st), uint64_t(st.st_size), frameIdx, downscale};
+
+	cache_shard&					shard = pimpl->shard(key);
+	std::shared_ptr<pending_decode> pending;
+	{
+		std::unique_lock<std::mutex> lock(shard.mutex);
+
+		auto it = shard.index.find(key);
+		if (it != shard.index.end())
+		{
+			shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+			++pimpl->hits;
+			return it->second->frame;
+		}
+
+		//! another thread is decoding this frame, wait for its result instead of decoding again
+		auto pending_it = shard.pending.find(key);
+		if (pending_it != shard.pending.end())
+		{
+			pending = pending_it->second;
+			pending->done_cond.wait(lock, [&pending] { return pending->done; });
+			++pimpl->hits;
+			if (err && pending->err != (unsigned int)APENG_ERROR::no_error)
+			{
+				*err = pending->err;
+			}
+			return pending->frame;
+		}
+
+		pending			   = std::make_shared<pending_decode>();
+		shard.pending[key] = pending;
+	}
+
+	pending_completion completion = {shard, key, pending, frame_ref(), (unsigned int)APENG_ERROR::out_of_memory};
+	++pimpl->misses;
+
+	//! frames 0..frameIdx are output, and decoding stops right after frameIdx
+	apeng_decode_options options;
+	memset(&options, 0, sizeof(options));
+	options.downscale = downscale;
+
+	//! the file may have been removed since stat()
+	cache_receiver		  receiver(frameIdx);
+	unsigned int		  load_err = (unsigned int)APENG_ERROR::file_invalid;
+	std::shared_ptr<FILE> file(fopen(filename, "rb"), fclose);
+	if (file)
+	{
+		load_err = decode_frames(file.get(), receiver, APENG_DIRTY_RECT_FCTL, &options);
+	}
+
+	frame_ref result;
+	if (load_err == decode_stopped && receiver.frames.size() == size_t(frameIdx) + 1)
+	{
+		load_err = (unsigned int)APENG_ERROR::no_error;
+		for (size_t i = 0; i < receiver.frames.size(); ++i)
+		{
+			cache_entry entry;
+			entry.key		   = key;
+			entry.key.frameIdx = (unsigned int)i;
+			entry.frame		   = receiver.frames[i];
+			entry.bytes		   = receiver.frames[i]->height * receiver.frames[i]->rowbytes;
+			pimpl->insert(std::move(entry));
+		}
+		result = receiver.frames.back();
+	}
+	else if (load_err == (unsigned int)APENG_ERROR::no_error || load_err == decode_stopped)
+	{
+		load_err = (unsigned int)APENG_ERROR::argument_invalid;
+	}
+
+	completion.frame = result;
+	completion.err	 = load_err;
+	if (err)
+	{
+		*err = load_err;
+	}
+
+	return result;
+}
+
+
+void apeng::frame_cache::clear()
+{
+	for (cache_shard& shard : pimpl->shards)
+	{
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		shard.index.clear();
+		shard.lru.clear();
+		shard.bytes = 0;
+	}
+}
+
+
+apeng::frame_cache_stats apeng::frame_cache::stats() const
+{
+	frame_cache_stats result;
+	result.hits		 = pimpl->hits;
+	result.misses	 = pimpl->misses;
+	result.evictions = pimpl->evictions;
+	result.bytes	 = 0;
+	result.frames	 = 0;
+
+	for (cache_shard& shard : pimpl->shards)
+	{
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		result.bytes += shard.bytes;
+		result.frames += shard.index.size();
+	}
+
+	return result;
+}
+
 #endif	//__cplusplus
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -32,7 +32,106 @@ extern "C" {
 
 // low-level C-API
 
+//! apeng_frame_info
+//! per-frame metadata returned by the *_info loaders
+typedef struct apeng_frame_info
+{
+	//! dirty rectangle: region of the canvas that changed since the previous frame
+	//!  covers the whole canvas for the first frame, may be empty (width == height == 0)
+	unsigned int x;
+	unsigned int y;
+	unsigned int width;
+	unsigned int height;
+
+	//! frame delay in seconds: delay_num / delay_den
+	unsigned short delay_num;
+	unsigned short delay_den;
+} apeng_frame_info;
+
+//! apeng_dirty_rect_mode
+//! how the *_info loaders compute apeng_frame_info's dirty rectangle
+enum apeng_dirty_rect_mode
+{
+	//! union of the fcTL rectangle and the region touched by the previous frame's dispose op
+	APENG_DIRTY_RECT_FCTL = 0,
+
+	//! bounding box of the pixels that actually differ from the previous frame
+	APENG_DIRTY_RECT_DIFF = 1,
+};
+
+//! apeng_decode_options
+//! restricts which frames the *_opts loaders decode and at which size
+//!  zero-initialize to decode all frames at full size
+typedef struct apeng_decode_options
+{
+	//! non-zero: only decode the default image, stopping before the rest of the file
+	unsigned int poster_only;
+
+	//! keep every frame_step-th frame, starting at frame 0; 0 or 1 keeps all frames
+	unsigned int frame_step;
+
+	//! if non-null, keep only the frames listed here, overriding frame_step
+	//!  indices past the last frame are ignored
+	const unsigned int* frame_indices;
+	unsigned int		frame_index_count;
+
+	//! box-filter frames down by this integer factor; 0 or 1 keeps full size
+	unsigned int downscale;
+
+	//! non-zero: read the file on a separate thread in blocks of this many bytes
+	//!  (capped at 16 MiB, rounded up to 4096), overlapping disk or network reads with decoding
+	//!  the file position after loading is then undefined
+	unsigned int readahead_block_size;
+
+	//! number of blocks the read-ahead thread may buffer, from 2 to 16
+	unsigned int readahead_depth;
+} apeng_decode_options;
+
+//! apeng_atlas_frame
+//! frame table entry of an atlas built by apeng_export_atlas / apeng_load_atlas
+typedef struct apeng_atlas_frame
+{
+	//! frame rectangle in the atlas, in pixels; empty for fully transparent trimmed frames
+	unsigned int atlas_x;
+	unsigned int atlas_y;
+	unsigned int width;
+	unsigned int height;
+
+	//! position of the rectangle within the original frame
+	unsigned int offset_x;
+	unsigned int offset_y;
+
+	//! frame rectangle in normalized texture coordinates
+	float u0;
+	float v0;
+	float u1;
+	float v1;
+
+	//! frame delay in seconds: delay_num / delay_den
+	unsigned short delay_num;
+	unsigned short delay_den;
+
+	//! index of the first frame with identical pixels, the frame's own index if unique
+	unsigned int source;
+} apeng_atlas_frame;
+
+//! apeng_atlas_flags
+//! options of apeng_export_atlas / apeng_load_atlas, may be or'ed
+enum apeng_atlas_flags
+{
+	//! crop frames to the bounds of their non-transparent pixels
+	APENG_ATLAS_TRIM = 0x1,
+
+	//! store identical frames only once
+	APENG_ATLAS_DEDUP = 0x2,
+
+	//! round atlas dimensions up to powers of two; the width then stays within the largest power of two <= max_width
+	APENG_ATLAS_POW2 = 0x4,
+};
+
+
 //--- load API
+//! on error the returned buffers and arrays are already freed and set to null
 
 //! apeng_load_frames_file_blob
 //! loads all frames into large buffer frame_blob
@@ -47,6 +146,20 @@ APENG_DLLIMPORT unsigned int APENG_API apeng_load_frames_file_blob(FILE*		 file,
 																   unsigned int* frames);
 
 
+//! apeng_load_frames_file_blob64
+//! loads all frames into large buffer frame_blob, with 64-bit sizes
+//!  frame_blob must be deleted by user using free()
+//!  returns an error instead of truncating if the blob size does not fit into size_t
+APENG_DLLIMPORT unsigned int APENG_API apeng_load_frames_file_blob64(FILE*		 file,
+																	 uint8_t**	 frames_blob,
+																	 size_t*	   frames_blob_size,
+																	 unsigned int* width,
+																	 unsigned int* height,
+																	 unsigned int* channels,
+																	 size_t*	   rowbytes,
+																	 unsigned int* frames);
+
+
 //! apeng_load_frames_file_nt
 //! loads all frames into null-terminated array of buffers
 //! all buffers and the returned array must be deleted using free()
@@ -78,6 +191,20 @@ APENG_DLLIMPORT unsigned int APENG_API apeng_load_frames_blob(const char*   file
 															  unsigned int* frames);
 
 
+//! apeng_load_frames_blob64
+//! loads all frames into large buffer frame_blob, with 64-bit sizes
+//!  frame_blob must be deleted by user using free()
+//!  returns an error instead of truncating if the blob size does not fit into size_t
+APENG_DLLIMPORT unsigned int APENG_API apeng_load_frames_blob64(const char*   filename,
+																uint8_t**	 frames_blob,
+																size_t*		  frames_blob_size,
+																unsigned int* width,
+																unsigned int* height,
+																unsigned int* channels,
+																size_t*		  rowbytes,
+																unsigned int* frames);
+
+
 //! apeng_load_frames_nt
 //! loads all frames into null-terminated array of buffers
 //! all buffers and the returned array must be deleted using free()
@@ -100,6 +227,67 @@ APENG_DLLIMPORT unsigned int APENG_API apeng_load_frames(const char*   filename,
 														 unsigned int* rowbytes);
 
 
+//! apeng_load_frames_file_info
+//! loads all frames array of buffers, along with per-frame info
+//!  dirty_rect_mode is one of apeng_dirty_rect_mode
+//! all buffers and the returned arrays must be deleted using free()
+APENG_DLLIMPORT unsigned int APENG_API apeng_load_frames_file_info(FILE*			   file,
+																   uint8_t***		   frames_array,
+																   apeng_frame_info** frames_info,
+																   unsigned int*	   frames,
+																   unsigned int*	   width,
+																   unsigned int*	   height,
+																   unsigned int*	   channels,
+																   unsigned int*	   rowbytes,
+																   unsigned int	   dirty_rect_mode);
+
+//! apeng_load_frames_info
+//! loads all frames array of buffers, along with per-frame info
+//!  dirty_rect_mode is one of apeng_dirty_rect_mode
+//! all buffers and the returned arrays must be deleted using free()
+APENG_DLLIMPORT unsigned int APENG_API apeng_load_frames_info(const char*		 filename,
+															  uint8_t***		 frames_array,
+															  apeng_frame_info** frames_info,
+															  unsigned int*		 frames,
+															  unsigned int*		 width,
+															  unsigned int*		 height,
+															  unsigned int*		 channels,
+															  unsigned int*		 rowbytes,
+															  unsigned int		 dirty_rect_mode);
+
+
+//! apeng_load_frames_file_opts
+//! loads the frames selected by options into an array of buffers, along with per-frame info
+//!  frames_info may be null, dirty rectangles are relative to the previous loaded frame
+//!  skipped frames are still decoded to composite later ones, but decoding stops after the last selected frame
+//! all buffers and the returned arrays must be deleted using free()
+APENG_DLLIMPORT unsigned int APENG_API apeng_load_frames_file_opts(FILE*						file,
+																   const apeng_decode_options* options,
+																   uint8_t***					frames_array,
+																   apeng_frame_info**			frames_info,
+																   unsigned int*				frames,
+																   unsigned int*				width,
+																   unsigned int*				height,
+																   unsigned int*				channels,
+																   unsigned int*				rowbytes,
+																   unsigned int				dirty_rect_mode);
+
+//! apeng_load_frames_opts
+//! loads the frames selected by options into an array of buffers, along with per-frame info
+//!  frames_info may be null, dirty rectangles are relative to the previous loaded frame
+//! all buffers and the returned arrays must be deleted using free()
+APENG_DLLIMPORT unsigned int APENG_API apeng_load_frames_opts(const char*				  filename,
+															  const apeng_decode_options* options,
+															  uint8_t***				  frames_array,
+															  apeng_frame_info**		  frames_info,
+															  unsigned int*				  frames,
+															  unsigned int*				  width,
+															  unsigned int*				  height,
+															  unsigned int*				  channels,
+															  unsigned int*				  rowbytes,
+															  unsigned int				  dirty_rect_mode);
+
+
 //--- save API
 
 //! apeng_save_frames_file_blob
@@ -115,6 +303,20 @@ APENG_DLLIMPORT unsigned int APENG_API apeng_save_frames_file_blob(FILE*		  file
 																   unsigned int   frames);
 
 
+//! apeng_save_frames_file_blob64
+//! saves all frames from large buffer frame_blob, with 64-bit sizes
+//!  frame_blob must be deleted by user using free()
+//!  returns an error if frames_blob_size does not match frames * height * rowbytes
+APENG_DLLIMPORT unsigned int APENG_API apeng_save_frames_file_blob64(FILE*		  file,
+																	 const uint8_t* frames_blob,
+																	 size_t		  frames_blob_size,
+																	 unsigned int   width,
+																	 unsigned int   height,
+																	 unsigned int   colortype,
+																	 size_t		  rowbytes,
+																	 unsigned int   frames);
+
+
 //! apeng_save_frames_file_nt
 //! saves all frames from null-terminated array of buffers
 //! all buffers and the returned array must be deleted using free()
@@ -146,6 +348,20 @@ APENG_DLLIMPORT unsigned int APENG_API apeng_save_frames_blob(const char*	filena
 															  unsigned int   frames);
 
 
+//! apeng_save_frames_blob64
+//! saves all frames from large buffer frame_blob, with 64-bit sizes
+//!  frame_blob must be deleted by user using free()
+//!  returns an error if frames_blob_size does not match frames * height * rowbytes
+APENG_DLLIMPORT unsigned int APENG_API apeng_save_frames_blob64(const char*	filename,
+																const uint8_t* frames_blob,
+																size_t		   frames_blob_size,
+																unsigned int   width,
+																unsigned int   height,
+																unsigned int   colortype,
+																size_t		   rowbytes,
+																unsigned int   frames);
+
+
 //! apeng_save_frames_nt
 //! saves all frames from null-terminated array of buffers
 //! all buffers and the returned array must be deleted using free()
@@ -168,6 +384,185 @@ APENG_DLLIMPORT unsigned int APENG_API apeng_save_frames(const char*	 filename,
 														 unsigned int	rowbytes);
 
 
+//--- mapped API
+//! out-of-core decoding into a raw-frame file backed by a memory mapping (POSIX only)
+
+//! apeng_load_frames_file_mapped
+//! decodes the frames selected by options (may be null) into the raw-frame file out_filename
+//! and returns them mapped into memory as one large buffer frames_blob
+//!  the file is sized from the header up front, frames are written in place
+//!  out_filename can later be mapped again using apeng_map_frames()
+//!  frames_blob must be released using apeng_unmap_frames()
+APENG_DLLIMPORT unsigned int APENG_API apeng_load_frames_file_mapped(FILE*						file,
+																	 const apeng_decode_options* options,
+																	 const char*				 out_filename,
+																	 uint8_t**					 frames_blob,
+																	 size_t*					 frames_blob_size,
+																	 unsigned int*				 width,
+																	 unsigned int*				 height,
+																	 unsigned int*				 channels,
+																	 size_t*					 rowbytes,
+																	 unsigned int*				 frames);
+
+//! apeng_load_frames_mapped
+//! decodes the frames selected by options (may be null) into the raw-frame file out_filename
+//! and returns them mapped into memory as one large buffer frames_blob
+//!  frames_blob must be released using apeng_unmap_frames()
+APENG_DLLIMPORT unsigned int APENG_API apeng_load_frames_mapped(const char*				   filename,
+																const apeng_decode_options* options,
+																const char*				   out_filename,
+																uint8_t**				   frames_blob,
+																size_t*					   frames_blob_size,
+																unsigned int*			   width,
+																unsigned int*			   height,
+																unsigned int*			   channels,
+																size_t*					   rowbytes,
+																unsigned int*			   frames);
+
+//! apeng_map_frames
+//! maps a raw-frame file written by apeng_load_frames_*_mapped() as one large buffer frames_blob
+//!  the mapping is private: writes to frames_blob do not reach the file
+//!  frames_blob must be released using apeng_unmap_frames()
+APENG_DLLIMPORT unsigned int APENG_API apeng_map_frames(const char*	  raw_filename,
+														uint8_t**	  frames_blob,
+														size_t*		  frames_blob_size,
+														unsigned int* width,
+														unsigned int* height,
+														unsigned int* channels,
+														size_t*		  rowbytes,
+														unsigned int* frames);
+
+//! apeng_unmap_frames
+//! releases a frames_blob returned by apeng_load_frames_*_mapped() or apeng_map_frames()
+APENG_DLLIMPORT void APENG_API apeng_unmap_frames(uint8_t* frames_blob, size_t frames_blob_size);
+
+
+//--- atlas API
+
+//! apeng_export_atlas
+//! packs frames_array into one atlas with a frame table
+//!  frames must be 4-channel BGRA as returned by the loaders, frames_info may be null
+//!  max_width == 0 lets the packer choose, padding adds transparent pixels between frames
+//!  flags is a combination of apeng_atlas_flags
+//!  atlas and atlas_frames must be deleted using free(), both are null on error
+APENG_DLLIMPORT unsigned int APENG_API apeng_export_atlas(const uint8_t**			frames_array,
+														  const apeng_frame_info* frames_info,
+														  unsigned int			  frames,
+														  unsigned int			  width,
+														  unsigned int			  height,
+														  unsigned int			  rowbytes,
+														  unsigned int			  max_width,
+														  unsigned int			  padding,
+														  unsigned int			  flags,
+														  uint8_t**				  atlas,
+														  unsigned int*			  atlas_width,
+														  unsigned int*			  atlas_height,
+														  apeng_atlas_frame**	  atlas_frames);
+
+//! apeng_load_atlas_file
+//! loads the frames selected by options (may be null) straight into an atlas with a frame table
+//!  only trimmed, unique frames are kept in memory while decoding
+//!  width and height receive the size of the original frames
+//!  atlas and atlas_frames must be deleted using free(), both are null on error
+APENG_DLLIMPORT unsigned int APENG_API apeng_load_atlas_file(FILE*						  file,
+															 const apeng_decode_options* options,
+															 unsigned int				  max_width,
+															 unsigned int				  padding,
+															 unsigned int				  flags,
+															 uint8_t**					  atlas,
+															 unsigned int*				  atlas_width,
+															 unsigned int*				  atlas_height,
+															 apeng_atlas_frame**		  atlas_frames,
+															 unsigned int*				  frames,
+															 unsigned int*				  width,
+															 unsigned int*				  height);
+
+//! apeng_load_atlas
+//! loads the frames selected by options (may be null) straight into an atlas with a frame table
+//!  width and height receive the size of the original frames
+//!  atlas and atlas_frames must be deleted using free(), both are null on error
+APENG_DLLIMPORT unsigned int APENG_API apeng_load_atlas(const char*				filename,
+														const apeng_decode_options* options,
+														unsigned int				max_width,
+														unsigned int				padding,
+														unsigned int				flags,
+														uint8_t**					atlas,
+														unsigned int*				atlas_width,
+														unsigned int*				atlas_height,
+														apeng_atlas_frame**			atlas_frames,
+														unsigned int*				frames,
+														unsigned int*				width,
+														unsigned int*				height);
+
+
+//--- edit API
+//! chunk-level editing: rewrites acTL/fcTL and frame chunk runs
+//! without decoding or re-encoding compressed pixel data
+
+//! apeng_edit_file_plays
+//! copies in_file to out_file with the acTL loop count set to plays
+//!  plays == 0 loops forever
+APENG_DLLIMPORT unsigned int APENG_API apeng_edit_file_plays(FILE* in_file, FILE* out_file, unsigned int plays);
+
+//! apeng_edit_file_delays
+//! copies in_file to out_file with the delay of frames [first, first + count)
+//! set to delay_num / delay_den seconds
+APENG_DLLIMPORT unsigned int APENG_API apeng_edit_file_delays(FILE*			 in_file,
+															  FILE*			 out_file,
+															  unsigned int	 first,
+															  unsigned int	 count,
+															  unsigned short delay_num,
+															  unsigned short delay_den);
+
+//! apeng_edit_file_trim
+//! copies frames [first, first + count) of in_file to out_file
+//!  if first > 0 the new first frame must cover the whole canvas; it is drawn onto a cleared canvas,
+//!  so translucent pixels it blended over the dropped frames show the background instead
+APENG_DLLIMPORT unsigned int APENG_API apeng_edit_file_trim(FILE*		 in_file,
+															FILE*		 out_file,
+															unsigned int first,
+															unsigned int count);
+
+//! apeng_edit_file_concat
+//! writes the frames of in_file_a followed by the frames of in_file_b to out_file
+//!  both inputs must share the same IHDR (and PLTE/tRNS if present)
+//!  and the first frame of in_file_b must cover the whole canvas
+APENG_DLLIMPORT unsigned int APENG_API apeng_edit_file_concat(FILE* in_file_a, FILE* in_file_b, FILE* out_file);
+
+
+//! apeng_edit_plays
+//! copies in_filename to out_filename with the acTL loop count set to plays
+//!  plays == 0 loops forever; out_filename may be in_filename
+APENG_DLLIMPORT unsigned int APENG_API apeng_edit_plays(const char* in_filename, const char* out_filename, unsigned int plays);
+
+//! apeng_edit_delays
+//! copies in_filename to out_filename with the delay of frames [first, first + count)
+//! set to delay_num / delay_den seconds; out_filename may be in_filename
+APENG_DLLIMPORT unsigned int APENG_API apeng_edit_delays(const char*	in_filename,
+														 const char*	out_filename,
+														 unsigned int   first,
+														 unsigned int   count,
+														 unsigned short delay_num,
+														 unsigned short delay_den);
+
+//! apeng_edit_trim
+//! copies frames [first, first + count) of in_filename to out_filename; out_filename may be in_filename
+//!  if first > 0 the new first frame must cover the whole canvas; it is drawn onto a cleared canvas,
+//!  so translucent pixels it blended over the dropped frames show the background instead
+APENG_DLLIMPORT unsigned int APENG_API apeng_edit_trim(const char*  in_filename,
+													   const char*  out_filename,
+													   unsigned int first,
+													   unsigned int count);
+
+//! apeng_edit_concat
+//! writes the frames of in_filename_a followed by the frames of in_filename_b to out_filename
+//!  both inputs must share the same IHDR (and PLTE/tRNS if present)
+//!  and the first frame of in_filename_b must cover the whole canvas; out_filename may be either input
+APENG_DLLIMPORT unsigned int APENG_API apeng_edit_concat(const char* in_filename_a,
+														 const char* in_filename_b,
+														 const char* out_filename);
+
+
 #ifdef __cplusplus
 }
 #endif	//__cplusplus
@@ -175,6 +570,8 @@ APENG_DLLIMPORT unsigned int APENG_API apeng_save_frames(const char*	 filename,
 
 #ifdef __cplusplus
 // higher-level C++ API
+#include <memory>
+
 namespace apeng
 {
 	//! load_frames
@@ -243,6 +640,87 @@ namespace apeng
 													   unsigned int* rowbytes);
 
 
+	//! load_frames
+	//! loads all frames array of buffers, along with per-frame info
+	//! all buffers and the returned arrays must be deleted using free()
+	APENG_DLLIMPORT unsigned int APENG_API load_frames(FILE*			  file,
+													   uint8_t***		  frames_array,
+													   apeng_frame_info** frames_info,
+													   unsigned int*	  frames,
+													   unsigned int*	  width,
+													   unsigned int*	  height,
+													   unsigned int*	  channels,
+													   unsigned int*	  rowbytes,
+													   unsigned int	  dirty_rect_mode = APENG_DIRTY_RECT_FCTL);
+
+	//! load_frames
+	//! loads all frames array of buffers, along with per-frame info
+	//! all buffers and the returned arrays must be deleted using free()
+	APENG_DLLIMPORT unsigned int APENG_API load_frames(const char*		  filename,
+													   uint8_t***		  frames_array,
+													   apeng_frame_info** frames_info,
+													   unsigned int*	  frames,
+													   unsigned int*	  width,
+													   unsigned int*	  height,
+													   unsigned int*	  channels,
+													   unsigned int*	  rowbytes,
+													   unsigned int	  dirty_rect_mode = APENG_DIRTY_RECT_FCTL);
+
+
+	//! load_frames64
+	//! loads all frames into large buffer frame_blob, with 64-bit sizes
+	//!  frame_blob must be deleted by user using free()
+	APENG_DLLIMPORT unsigned int APENG_API load_frames64(FILE*		   file,
+														 uint8_t**	   frames_blob,
+														 size_t*	   frames_blob_size,
+														 unsigned int* width,
+														 unsigned int* height,
+														 unsigned int* channels,
+														 size_t*	   rowbytes,
+														 unsigned int* frames);
+
+	//! load_frames64
+	//! loads all frames into large buffer frame_blob, with 64-bit sizes
+	//!  frame_blob must be deleted by user using free()
+	APENG_DLLIMPORT unsigned int APENG_API load_frames64(const char*   filename,
+														 uint8_t**	   frames_blob,
+														 size_t*	   frames_blob_size,
+														 unsigned int* width,
+														 unsigned int* height,
+														 unsigned int* channels,
+														 size_t*	   rowbytes,
+														 unsigned int* frames);
+
+
+	//! load_frames
+	//! loads the frames selected by options into an array of buffers, along with per-frame info
+	//! all buffers and the returned arrays must be deleted using free()
+	APENG_DLLIMPORT unsigned int APENG_API load_frames(FILE*					   file,
+													   const apeng_decode_options& options,
+													   uint8_t***				   frames_array,
+													   apeng_frame_info**		   frames_info,
+													   unsigned int*			   frames,
+													   unsigned int*			   width,
+													   unsigned int*			   height,
+													   unsigned int*			   channels,
+													   unsigned int*			   rowbytes,
+													   unsigned int				   dirty_rect_mode = APENG_DIRTY_RECT_FCTL);
+
+	//! load_frames
+	//! loads the frames selected by options into an array of buffers, along with per-frame info
+	//! all buffers and the returned arrays must be deleted using free()
+	APENG_DLLIMPORT unsigned int APENG_API load_frames(const char*				   filename,
+													   const apeng_decode_options& options,
+													   uint8_t***				   frames_array,
+													   apeng_frame_info**		   frames_info,
+													   unsigned int*			   frames,
+													   unsigned int*			   width,
+													   unsigned int*			   height,
+													   unsigned int*			   channels,
+													   unsigned int*			   rowbytes,
+													   unsigned int				   dirty_rect_mode = APENG_DIRTY_RECT_FCTL);
+
+
 	//--- save API
 
 	//! save_frames
@@ -309,6 +787,244 @@ namespace apeng
 													   unsigned int	height,
 													   unsigned int	colortype,
 													   unsigned int	rowbytes);
+
+
+	//! save_frames64
+	//! saves all frames from large buffer frame_blob, with 64-bit sizes
+	//!  frame_blob must be deleted by user using free()
+	APENG_DLLIMPORT unsigned int APENG_API save_frames64(FILE*			file,
+														 const uint8_t* frames_blob,
+														 size_t			frames_blob_size,
+														 unsigned int	width,
+														 unsigned int	height,
+														 unsigned int	colortype,
+														 size_t			rowbytes,
+														 unsigned int	frames);
+
+	//! save_frames64
+	//! saves all frames from large buffer frame_blob, with 64-bit sizes
+	//!  frame_blob must be deleted by user using free()
+	APENG_DLLIMPORT unsigned int APENG_API save_frames64(const char*	filename,
+														 const uint8_t* frames_blob,
+														 size_t			frames_blob_size,
+														 unsigned int	width,
+														 unsigned int	height,
+														 unsigned int	colortype,
+														 size_t			rowbytes,
+														 unsigned int	frames);
+
+
+	//--- edit API
+
+	//! edit_plays
+	//! copies in_file to out_file with the acTL loop count set to plays
+	APENG_DLLIMPORT unsigned int APENG_API edit_plays(FILE* in_file, FILE* out_file, unsigned int plays);
+
+	//! edit_delays
+	//! copies in_file to out_file with the delay of frames [first, first + count) set
+	APENG_DLLIMPORT unsigned int APENG_API edit_delays(FILE*		  in_file,
+													   FILE*		  out_file,
+													   unsigned int   first,
+													   unsigned int   count,
+													   unsigned short delay_num,
+													   unsigned short delay_den);
+
+	//! edit_trim
+	//! copies frames [first, first + count) of in_file to out_file
+	APENG_DLLIMPORT unsigned int APENG_API edit_trim(FILE* in_file, FILE* out_file, unsigned int first, unsigned int count);
+
+	//! edit_concat
+	//! writes the frames of in_file_a followed by the frames of in_file_b to out_file
+	APENG_DLLIMPORT unsigned int APENG_API edit_concat(FILE* in_file_a, FILE* in_file_b, FILE* out_file);
+
+
+	//! edit_plays
+	//! copies in_filename to out_filename with the acTL loop count set to plays
+	APENG_DLLIMPORT unsigned int APENG_API edit_plays(const char* in_filename, const char* out_filename, unsigned int plays);
+
+	//! edit_delays
+	//! copies in_filename to out_filename with the delay of frames [first, first + count) set
+	APENG_DLLIMPORT unsigned int APENG_API edit_delays(const char*	in_filename,
+													   const char*	out_filename,
+													   unsigned int   first,
+													   unsigned int   count,
+													   unsigned short delay_num,
+													   unsigned short delay_den);
+
+	//! edit_trim
+	//! copies frames [first, first + count) of in_filename to out_filename
+	APENG_DLLIMPORT unsigned int APENG_API edit_trim(const char*  in_filename,
+													 const char*  out_filename,
+													 unsigned int first,
+													 unsigned int count);
+
+	//! edit_concat
+	//! writes the frames of in_filename_a followed by the frames of in_filename_b to out_filename
+	APENG_DLLIMPORT unsigned int APENG_API edit_concat(const char* in_filename_a,
+													   const char* in_filename_b,
+													   const char* out_filename);
+
+
+	//--- mapped API
+
+	//! load_frames_mapped
+	//! decodes the frames selected by options (may be null) into the raw-frame file out_filename
+	//!  frames_blob must be released using unmap_frames()
+	APENG_DLLIMPORT unsigned int APENG_API load_frames_mapped(FILE*						  file,
+															  const apeng_decode_options* options,
+															  const char*				  out_filename,
+															  uint8_t**					  frames_blob,
+															  size_t*					  frames_blob_size,
+															  unsigned int*				  width,
+															  unsigned int*				  height,
+															  unsigned int*				  channels,
+															  size_t*					  rowbytes,
+															  unsigned int*				  frames);
+
+	//! load_frames_mapped
+	//! decodes the frames selected by options (may be null) into the raw-frame file out_filename
+	//!  frames_blob must be released using unmap_frames()
+	APENG_DLLIMPORT unsigned int APENG_API load_frames_mapped(const char*				  filename,
+															  const apeng_decode_options* options,
+															  const char*				  out_filename,
+															  uint8_t**					  frames_blob,
+															  size_t*					  frames_blob_size,
+															  unsigned int*				  width,
+															  unsigned int*				  height,
+															  unsigned int*				  channels,
+															  size_t*					  rowbytes,
+															  unsigned int*				  frames);
+
+	//! map_frames
+	//! maps a raw-frame file written by load_frames_mapped()
+	//!  frames_blob must be released using unmap_frames()
+	APENG_DLLIMPORT unsigned int APENG_API map_frames(const char*	raw_filename,
+													  uint8_t**		frames_blob,
+													  size_t*		frames_blob_size,
+													  unsigned int* width,
+													  unsigned int* height,
+													  unsigned int* channels,
+													  size_t*		rowbytes,
+													  unsigned int* frames);
+
+	//! unmap_frames
+	//! releases a frames_blob returned by load_frames_mapped() or map_frames()
+	APENG_DLLIMPORT void APENG_API unmap_frames(uint8_t* frames_blob, size_t frames_blob_size);
+
+
+	//--- atlas API
+
+	//! export_atlas
+	//! packs frames_array into one atlas with a frame table
+	//!  atlas and atlas_frames must be deleted using free()
+	APENG_DLLIMPORT unsigned int APENG_API export_atlas(const uint8_t**			 frames_array,
+														const apeng_frame_info* frames_info,
+														unsigned int			 frames,
+														unsigned int			 width,
+														unsigned int			 height,
+														unsigned int			 rowbytes,
+														unsigned int			 max_width,
+														unsigned int			 padding,
+														unsigned int			 flags,
+														uint8_t**				 atlas,
+														unsigned int*			 atlas_width,
+														unsigned int*			 atlas_height,
+														apeng_atlas_frame**		 atlas_frames);
+
+	//! load_atlas
+	//! loads the frames selected by options (may be null) straight into an atlas with a frame table
+	//!  atlas and atlas_frames must be deleted using free()
+	APENG_DLLIMPORT unsigned int APENG_API load_atlas(FILE*						file,
+													  const apeng_decode_options* options,
+													  unsigned int				max_width,
+													  unsigned int				padding,
+													  unsigned int				flags,
+													  uint8_t**					atlas,
+													  unsigned int*				atlas_width,
+													  unsigned int*				atlas_height,
+													  apeng_atlas_frame**		atlas_frames,
+													  unsigned int*				frames,
+													  unsigned int*				width,
+													  unsigned int*				height);
+
+	//! load_atlas
+	//! loads the frames selected by options (may be null) straight into an atlas with a frame table
+	//!  atlas and atlas_frames must be deleted using free()
+	APENG_DLLIMPORT unsigned int APENG_API load_atlas(const char*				filename,
+													  const apeng_decode_options* options,
+													  unsigned int				max_width,
+													  unsigned int				padding,
+													  unsigned int				flags,
+													  uint8_t**					atlas,
+													  unsigned int*				atlas_width,
+													  unsigned int*				atlas_height,
+													  apeng_atlas_frame**		atlas_frames,
+													  unsigned int*				frames,
+													  unsigned int*				width,
+													  unsigned int*				height);
+
+
+	//--- frame cache
+
+	//! frame_view
+	//! read-only decoded frame handed out by frame_cache
+	struct frame_view
+	{
+		const uint8_t*	 pixels;
+		unsigned int	 width;
+		unsigned int	 height;
+		unsigned int	 channels;
+		size_t			 rowbytes;
+		apeng_frame_info info;
+	};
+
+	//! frame_ref
+	//! refcounted frame_view, stays valid after eviction until the last reference is dropped
+	typedef std::shared_ptr<const frame_view> frame_ref;
+
+	//! frame_cache_stats
+	//! snapshot of frame_cache counters
+	struct frame_cache_stats
+	{
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t evictions;
+		size_t	 bytes;	//! pixel bytes currently held by the cache
+		size_t	 frames;   //! frames currently held by the cache
+	};
+
+	//! frame_cache
+	//! thread-safe cache of decoded frames, bounded by a pixel byte budget
+	//!  frames are keyed by (filename, mtime, file size, frame index, downscale) and evicted least-recently-used first
+	//!  locking is sharded by key, each shard holding budget / shards bytes; larger frames are not cached
+	class APENG_DLLIMPORT frame_cache
+	{
+	public:
+		explicit frame_cache(size_t budget, unsigned int shards = 16);
+		~frame_cache();
+
+		frame_cache(const frame_cache&) = delete;
+		frame_cache& operator=(const frame_cache&) = delete;
+
+		//! get
+		//! returns frame frameIdx of filename, downscaled by downscale
+		//!  a miss decodes the file up to frameIdx and caches frames 0..frameIdx, so walking forward through an
+		//!  uncached N-frame animation costs N(N+1)/2 frame decodes; getting the last wanted frame first decodes once
+		//!  concurrent misses of the same frame share one decode
+		//!  returns an empty frame_ref and sets err (if non-null) on failure
+		frame_ref get(const char* filename, unsigned int frameIdx, unsigned int* err = nullptr, unsigned int downscale = 1);
+
+		//! clear
+		//! drops all cached frames, outstanding frame_refs stay valid
+		void clear();
+
+		//! stats
+		frame_cache_stats stats() const;
+
+	private:
+		struct impl;
+		impl* pimpl;
+	};
 }	// namespace apeng
 #endif	//__cplusplus
 